@@ -0,0 +1,188 @@
+/** @file AdcScanner.cpp
+ *
+ * Continuous multi-channel ADC acquisition on the STM32F030 panel MCU.
+ *
+ * ADC1 runs in continuous scan mode from PCLK/4 (12 MHz) with the longest
+ * sample time, about 47 k conversions per second over all channels. DMA1
+ * channel 1 moves them into the circular buffer; with two channels and 16
+ * samples each per half that is roughly 1.5 k averaging interrupts per
+ * second of a few microseconds each.
+ *
+ * @license: BSD 3-Clause License
+ */
+#if defined(TARGET_STM32F0)
+
+#include "AdcScanner.hpp"
+
+#include "stm32f0xx_hal.h"
+
+#define ADC_DMA_IRQn			DMA1_Channel1_IRQn
+#define ADC_DMA_IRQ_PRIORITY	3	// below the NTS-1 link
+#define ADC_DMA_IRQ_HANDLER		DMA1_Channel1_IRQHandler
+#define ADC_WAIT_LOOPS			100000UL
+
+
+struct AdcInput {
+	GPIO_TypeDef *port;
+	uint8_t pin;
+	uint8_t channel;
+};
+
+// Indexed by AdcScanner::Channel, ascending ADC channel order
+static const AdcInput kInputs[AdcScanner::COUNT] = {
+	{ GPIOA, 0, 0 },	// RIBBON: PA_0, ADC_IN0
+	{ GPIOC, 2, 12 },	// POT: PC_2, ADC_IN12
+};
+
+static AdcScanner *sScanner;	// served by the DMA interrupt
+
+
+static bool sWait(volatile uint32_t *reg, uint32_t mask, uint32_t value)
+{
+	for (uint32_t n = 0; n < ADC_WAIT_LOOPS; n++) {
+		if ((*reg & mask) == value) {
+			return true;
+		}
+	}
+	return false;
+}
+
+AdcScanner::AdcScanner() noexcept
+	: buffer(), values(), blockCount(0), listener(nullptr), listenerCtx(nullptr)
+{
+}
+
+AdcScanner::~AdcScanner()
+{
+	stop();
+}
+
+void AdcScanner::attach(BlockListener fn, void *ctx) noexcept
+{
+	HAL_NVIC_DisableIRQ(ADC_DMA_IRQn);
+	listener = fn;
+	listenerCtx = ctx;
+	if (sScanner == this) {
+		HAL_NVIC_EnableIRQ(ADC_DMA_IRQn);
+	}
+}
+
+bool AdcScanner::start() noexcept
+{
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	__HAL_RCC_ADC1_CLK_ENABLE();
+
+	uint32_t chselr = 0;
+	for (const AdcInput &in: kInputs) {
+		in.port->MODER |= 3UL << (2 * in.pin);	// analog mode
+		in.port->PUPDR &= ~(3UL << (2 * in.pin));
+		chselr |= 1UL << in.channel;
+	}
+
+	// Calibrate with the ADC disabled
+	if (ADC1->CR & ADC_CR_ADEN) {
+		ADC1->CR |= ADC_CR_ADDIS;
+		if (!sWait(&ADC1->CR, ADC_CR_ADEN, 0)) {
+			return false;
+		}
+	}
+	ADC1->CFGR1 &= ~ADC_CFGR1_DMAEN;
+	ADC1->CFGR2 = ADC_CFGR2_CKMODE_1;	// PCLK/4
+	ADC1->CR |= ADC_CR_ADCAL;
+	if (!sWait(&ADC1->CR, ADC_CR_ADCAL, 0)) {
+		return false;
+	}
+
+	// 12 bit, right aligned, scan upwards, continuous, circular DMA
+	ADC1->CFGR1 = ADC_CFGR1_CONT | ADC_CFGR1_DMACFG | ADC_CFGR1_DMAEN;
+	ADC1->SMPR = ADC_SMPR_SMP;	// 239.5 cycles, pots have high impedance
+	ADC1->CHSELR = chselr;
+
+	DMA1_Channel1->CCR = 0;
+	DMA1_Channel1->CPAR = (uint32_t)&ADC1->DR;
+	DMA1_Channel1->CMAR = (uint32_t)buffer;
+	DMA1_Channel1->CNDTR = 2 * HALF;
+	DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0
+		| DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+	DMA1->IFCR = DMA_IFCR_CGIF1;
+	DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+	sScanner = this;
+	HAL_NVIC_SetPriority(ADC_DMA_IRQn, ADC_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(ADC_DMA_IRQn);
+
+	ADC1->ISR = ADC_ISR_ADRDY;
+	ADC1->CR |= ADC_CR_ADEN;
+	if (!sWait(&ADC1->ISR, ADC_ISR_ADRDY, ADC_ISR_ADRDY)) {
+		stop();
+		return false;
+	}
+	ADC1->CR |= ADC_CR_ADSTART;
+	return true;
+}
+
+void AdcScanner::stop() noexcept
+{
+	if (sScanner != this) {
+		return;
+	}
+	HAL_NVIC_DisableIRQ(ADC_DMA_IRQn);
+	if (ADC1->CR & ADC_CR_ADSTART) {
+		ADC1->CR |= ADC_CR_ADSTP;
+		sWait(&ADC1->CR, ADC_CR_ADSTP, 0);
+	}
+	if (ADC1->CR & ADC_CR_ADEN) {
+		ADC1->CR |= ADC_CR_ADDIS;
+		sWait(&ADC1->CR, ADC_CR_ADEN, 0);
+	}
+	DMA1_Channel1->CCR = 0;
+	sScanner = nullptr;
+}
+
+void AdcScanner::average(const uint16_t *samples) noexcept
+{
+	uint32_t sums[COUNT] = {};
+	for (uint16_t i = 0; i < HALF; i += COUNT) {
+		for (uint8_t ch = 0; ch < COUNT; ch++) {
+			sums[ch] += samples[i + ch];
+		}
+	}
+	uint16_t latest[COUNT];
+	for (uint8_t ch = 0; ch < COUNT; ch++) {
+		latest[ch] = (uint16_t)(sums[ch] / OVERSAMPLE);
+		values[ch] = latest[ch];
+	}
+	blockCount++;
+	if (listener != nullptr) {
+		listener(listenerCtx, latest, COUNT);
+	}
+}
+
+void AdcScanner::handleIrq() noexcept
+{
+	const uint32_t isr = DMA1->ISR;
+	if (isr & DMA_ISR_HTIF1) {
+		DMA1->IFCR = DMA_IFCR_CHTIF1;
+		average(&buffer[0]);
+	}
+	if (isr & DMA_ISR_TCIF1) {
+		DMA1->IFCR = DMA_IFCR_CTCIF1;
+		average(&buffer[HALF]);
+	}
+	if (isr & DMA_ISR_TEIF1) {
+		DMA1->IFCR = DMA_IFCR_CTEIF1;
+	}
+}
+
+extern "C" void ADC_DMA_IRQ_HANDLER(void)
+{
+	if (sScanner != nullptr) {
+		sScanner->handleIrq();
+	}
+}
+
+#endif // TARGET_STM32F0
+
+/* EOF */
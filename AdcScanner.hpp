@@ -0,0 +1,77 @@
+/** @file AdcScanner.hpp
+ *
+ * Continuous multi-channel ADC acquisition on the STM32F030 panel MCU.
+ *
+ * The ADC converts every channel of the table in AdcScanner.cpp in a
+ * continuous scan and DMA writes the samples into a circular buffer, so
+ * no conversion ever blocks the CPU. Each half of the buffer holds
+ * OVERSAMPLE samples per channel. The DMA half and full transfer
+ * interrupts average the finished half into the latest value of each
+ * channel (the F030 ADC has no hardware oversampler). read() returns that
+ * value at any time without waiting.
+ *
+ * To add a pot, add its pin and ADC channel to the table and a name to
+ * Channel; keep both in ascending channel order, the ADC scans that way.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef AdcScanner_hpp
+#define AdcScanner_hpp
+
+#if defined(TARGET_STM32F0)
+
+#include <cstdint>
+
+
+class AdcScanner {
+public:
+	enum Channel : uint8_t {
+		RIBBON = 0,		// PA_0, ADC_IN0
+		POT,			// PC_2, ADC_IN12
+		COUNT
+	};
+
+	static const uint8_t OVERSAMPLE = 16;	// samples averaged per value
+
+	/**
+	 * Called from the DMA interrupt with the new 12 bit values of all
+	 * channels every time a block has been averaged
+	 */
+	typedef void (*BlockListener)(void *ctx, const uint16_t *values, uint8_t count);
+
+	AdcScanner() noexcept;
+	~AdcScanner();
+
+	/** Calibrate the ADC and start the scan, false when it did not come up */
+	bool start() noexcept;
+	void stop() noexcept;
+
+	/** Latest averaged value, 12 bit */
+	uint16_t read(Channel ch) const noexcept { return values[ch]; }
+
+	/** Latest averaged value scaled to 10 bit, like the controls expect */
+	uint16_t read10(Channel ch) const noexcept { return values[ch] >> 2; }
+
+	void attach(BlockListener fn, void *ctx) noexcept;
+
+	/** Averaged blocks since start(), wraps around */
+	uint32_t blocks() const noexcept { return blockCount; }
+
+	/** Called from the DMA interrupt handler only */
+	void handleIrq() noexcept;
+
+private:
+	static const uint16_t HALF = (uint16_t)COUNT * OVERSAMPLE;
+
+	void average(const uint16_t *samples) noexcept;
+
+	uint16_t buffer[2 * HALF];	// written by DMA, channels interleaved
+	volatile uint16_t values[COUNT];
+	volatile uint32_t blockCount;
+	BlockListener listener;
+	void *listenerCtx;
+};
+
+#endif // TARGET_STM32F0
+
+#endif /* AdcScanner_hpp */
@@ -0,0 +1,78 @@
+/** @file AnalogConditioner.cpp
+ *
+ * Integer-only conditioning for one analog control (pot, ribbon).
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "AnalogConditioner.hpp"
+
+
+constexpr AnalogConditioner::Config AnalogConditioner::DEFAULT_CONFIG;
+
+
+AnalogConditioner::AnalogConditioner(const Config &config) noexcept
+	: config(config), acc(0), out(0), changed(false), primed(false),
+	  changeCount(0)
+{
+}
+
+void AnalogConditioner::reset(uint16_t raw) noexcept
+{
+	if (raw > config.max) {
+		raw = config.max;
+	}
+	acc = (int32_t)raw << FRAC;
+	out = raw;
+	primed = true;
+}
+
+bool AnalogConditioner::update(uint16_t raw) noexcept
+{
+	if (raw > config.max) {
+		raw = config.max;
+	}
+	if (!primed) {
+		reset(raw);
+		changed = true;
+		changeCount++;
+		return true;
+	}
+
+	// One-pole low-pass, arithmetic shift keeps the sign
+	const int32_t target = (int32_t)raw << FRAC;
+	const int32_t delta = target - acc;
+	const int32_t absDelta = (delta < 0) ? -delta : delta;
+	const bool fast = config.fastDelta != 0
+		&& absDelta > ((int32_t)config.fastDelta << FRAC);
+	acc += delta >> (fast ? config.fastShift : config.shift);
+
+	// Round to the nearest output step
+	int32_t filtered = (acc + (1 << (FRAC - 1))) >> FRAC;
+	if (filtered < 0) {
+		filtered = 0;
+	} else if (filtered > config.max) {
+		filtered = config.max;
+	}
+
+	const int32_t moved = filtered - (int32_t)out;
+	const bool atEnd = (filtered == 0 || filtered == config.max) && moved != 0;
+	if (!atEnd && moved <= config.deadband && moved >= -(int32_t)config.deadband) {
+		return false;
+	}
+	out = (uint16_t)filtered;
+	changed = true;
+	changeCount++;
+	return true;
+}
+
+bool AnalogConditioner::takeChange() noexcept
+{
+	if (!changed) {
+		return false;
+	}
+	// Clear before the caller reads value(), a newer change flags again
+	changed = false;
+	return true;
+}
+
+/* EOF */
@@ -0,0 +1,66 @@
+/** @file AnalogConditioner.hpp
+ *
+ * Integer-only conditioning for one analog control (pot, ribbon).
+ *
+ * Each raw sample goes through a one-pole low-pass (exponential moving
+ * average with alpha = 1/2^shift, kept with 8 fraction bits). When the
+ * input is far from the filtered value the filter uses a short time
+ * constant so real movements are followed without lag. The output only
+ * moves when the filtered value leaves a deadband around the last output,
+ * except at both ends of the range, which are always reachable. A change
+ * flag tells the consumer when the output actually moved, so ADC noise
+ * does not turn into parameter changes on the link.
+ *
+ * update() is cheap enough for the ADC block interrupt; takeChange() and
+ * value() may be called from the main loop meanwhile.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef AnalogConditioner_hpp
+#define AnalogConditioner_hpp
+
+#include <cstdint>
+
+
+class AnalogConditioner {
+public:
+	struct Config {
+		uint16_t max;		// highest input and output value
+		uint8_t shift;		// filter alpha 1/2^shift, 0 disables filtering
+		uint8_t fastShift;	// alpha used for large steps
+		uint16_t fastDelta;	// step from the filtered value that counts as large, 0 = never
+		uint16_t deadband;	// output LSBs the filtered value must move by
+	};
+
+	/** 10 bit control, about 11 ms time constant at 1.5 kHz, 2 LSB deadband */
+	static constexpr Config DEFAULT_CONFIG = { 1023, 4, 1, 32, 2 };
+
+	explicit AnalogConditioner(const Config &config = DEFAULT_CONFIG) noexcept;
+
+	/** Feed one raw sample, true when the output changed */
+	bool update(uint16_t raw) noexcept;
+
+	/** Restart the filter at the given input value */
+	void reset(uint16_t raw) noexcept;
+
+	/** Conditioned value, 0..max */
+	uint16_t value() const noexcept { return out; }
+
+	/** True once after the output changed since the last call */
+	bool takeChange() noexcept;
+
+	/** Output changes since construction */
+	uint32_t changes() const noexcept { return changeCount; }
+
+private:
+	static const uint8_t FRAC = 8;
+
+	Config config;
+	int32_t acc;		// filtered value << FRAC
+	volatile uint16_t out;
+	volatile bool changed;
+	bool primed;
+	uint32_t changeCount;
+};
+
+#endif /* AnalogConditioner_hpp */
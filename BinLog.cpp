@@ -0,0 +1,60 @@
+/** @file BinLog.cpp
+ *
+ * Deferred binary logging for the control loop.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "BinLog.hpp"
+
+
+BinLog::BinLog() noexcept
+	: ring(), widx(0), ridx(0), lostCount(0), lostReported(0)
+#if defined(TARGET_LIKE_MBED)
+	// Same pins and rate as the console, printf keeps working alongside
+	, uart(USBTX, USBRX, MBED_CONF_PLATFORM_STDIO_BAUD_RATE)
+#endif
+{
+}
+
+void BinLog::reportLost() noexcept
+{
+	const uint32_t lostNow = lostCount;
+	if (lostNow != lostReported
+		&& (uint16_t)(RING_SIZE - (widx - ridx)) >= 2 + 4) {
+		log(LOST, lostNow - lostReported);
+		lostReported = lostNow;
+	}
+}
+
+uint16_t BinLog::read(uint8_t *dst, uint16_t max) noexcept
+{
+	reportLost();
+	uint16_t n = 0;
+	while (n < max && ridx != widx) {
+		dst[n++] = ring[ridx++ & MASK];
+	}
+	return n;
+}
+
+#if defined(TARGET_LIKE_MBED)
+uint16_t BinLog::drain() noexcept
+{
+	reportLost();
+	uint16_t n = 0;
+	while (ridx != widx && uart.writeable()) {
+		uart.putc(ring[ridx++ & MASK]);
+		n++;
+	}
+	return n;
+}
+
+void BinLog::flush() noexcept
+{
+	reportLost();
+	while (ridx != widx) {
+		uart.putc(ring[ridx++ & MASK]);	// waits for the data register
+	}
+}
+#endif
+
+/* EOF */
@@ -0,0 +1,160 @@
+/** @file BinLog.hpp
+ *
+ * Deferred binary logging for the control loop.
+ *
+ * A log call does not format anything: it copies a one byte format ID
+ * and its arguments into a RAM ring, a few dozen cycles instead of the
+ * UART time of a printf. A low priority task later drains the ring to
+ * the console with drain(), a byte at a time while the UART can take it,
+ * so nothing ever waits for the serial port.
+ *
+ * Record on the wire: SYNC, format ID, then per argument 4 bytes little
+ * endian, or a length byte and up to MAX_STRING characters for %s.
+ * Plain text printed with printf may appear between records, but a
+ * record goes out over several drain() calls: call flush() before
+ * printing directly so text never lands inside a record;
+ * tools/binlog_decode.py passes text through and turns records back into
+ * lines using the format strings in BINLOG_FORMATS below.
+ *
+ * The ring has one producer and one consumer, both in the main loop
+ * (scheduler tasks); do not log from interrupts. A record that does not
+ * fit is dropped and counted, drain() reports the count with a LOST
+ * record once there is room again.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef BinLog_hpp
+#define BinLog_hpp
+
+#include <cstdint>
+
+#if defined(TARGET_LIKE_MBED)
+#include "mbed.h"
+#endif
+
+#ifdef MBED_CONF_APP_BINLOG_RING_SIZE
+#define BINLOG_RING_SIZE MBED_CONF_APP_BINLOG_RING_SIZE
+#else
+#define BINLOG_RING_SIZE 256
+#endif
+
+/*
+ * Format table, the decoder reads it from this file. Append only: the
+ * position is the ID on the wire. Conversions: %u %d %x %c %s, with an
+ * optional l.
+ */
+#define BINLOG_FORMATS(X) \
+	X(LOST,			"binlog: %lu records lost") \
+	X(PARAM,		"%s: %u") \
+	X(INIT_DONE,	"init done, filter type %u") \
+	X(INIT_NO_REPLY, "init done, no reply from main board") \
+	X(RIBBON_NOTE,	"ribbon zone %u note %u") \
+
+
+class BinLog {
+public:
+	static const uint16_t RING_SIZE = BINLOG_RING_SIZE;
+	static const uint8_t SYNC = 0x1E;		// ASCII record separator
+	static const uint8_t MAX_STRING = 15;
+
+	static_assert(RING_SIZE >= 64 && (RING_SIZE & (RING_SIZE - 1)) == 0,
+				  "binlog-ring-size must be a power of two, at least 64");
+
+#define BINLOG_ID(id, fmt) id,
+	enum Id : uint8_t {
+		BINLOG_FORMATS(BINLOG_ID)
+		COUNT
+	};
+#undef BINLOG_ID
+
+	BinLog() noexcept;
+
+	/** Queue a record, arguments are integers or C strings */
+	template <typename... Args>
+	void log(Id id, Args... args) noexcept {
+		const uint16_t size = 2 + sizeOf(args...);
+		if ((uint16_t)(RING_SIZE - (widx - ridx)) < size) {
+			lostCount++;
+			return;
+		}
+		uint16_t w = widx;
+		ring[w++ & MASK] = SYNC;
+		ring[w++ & MASK] = id;
+		put(w, args...);
+		widx = w;	// the whole record appears at once
+	}
+
+	/** Copy up to max queued bytes out, for drain() and host tests */
+	uint16_t read(uint8_t *dst, uint16_t max) noexcept;
+
+#if defined(TARGET_LIKE_MBED)
+	/** Write queued bytes while the UART has room, returns the count */
+	uint16_t drain() noexcept;
+
+	/** Write everything queued, waiting for the UART; before a printf */
+	void flush() noexcept;
+#endif
+
+	uint16_t pending() const noexcept { return (uint16_t)(widx - ridx); }
+
+	/** Records dropped because the ring was full */
+	uint32_t lost() const noexcept { return lostCount; }
+
+private:
+	static const uint16_t MASK = RING_SIZE - 1;
+
+	static uint16_t sizeOf() noexcept { return 0; }
+
+	template <typename... Rest>
+	static uint16_t sizeOf(const char *s, Rest... rest) noexcept {
+		return 1 + length(s) + sizeOf(rest...);
+	}
+
+	template <typename T, typename... Rest>
+	static uint16_t sizeOf(T, Rest... rest) noexcept {
+		return 4 + sizeOf(rest...);
+	}
+
+	static uint8_t length(const char *s) noexcept {
+		uint8_t n = 0;
+		while (s != nullptr && s[n] != '\0' && n < MAX_STRING) {
+			n++;
+		}
+		return n;
+	}
+
+	void put(uint16_t &) noexcept {}
+
+	template <typename... Rest>
+	void put(uint16_t &w, const char *s, Rest... rest) noexcept {
+		const uint8_t n = length(s);
+		ring[w++ & MASK] = n;
+		for (uint8_t i = 0; i < n; i++) {
+			ring[w++ & MASK] = (uint8_t)s[i];
+		}
+		put(w, rest...);
+	}
+
+	template <typename T, typename... Rest>
+	void put(uint16_t &w, T value, Rest... rest) noexcept {
+		const uint32_t v = (uint32_t)value;
+		ring[w++ & MASK] = (uint8_t)v;
+		ring[w++ & MASK] = (uint8_t)(v >> 8);
+		ring[w++ & MASK] = (uint8_t)(v >> 16);
+		ring[w++ & MASK] = (uint8_t)(v >> 24);
+		put(w, rest...);
+	}
+
+	void reportLost() noexcept;
+
+	uint8_t ring[RING_SIZE];
+	uint16_t widx;				// free running, masked on access
+	uint16_t ridx;
+	uint32_t lostCount;
+	uint32_t lostReported;
+#if defined(TARGET_LIKE_MBED)
+	RawSerial uart;
+#endif
+};
+
+#endif /* BinLog_hpp */
@@ -0,0 +1,196 @@
+/** @file ControlMap.cpp
+ *
+ * Declarative mapping of panel controls onto NTS-1 parameters.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "ControlMap.hpp"
+
+
+ControlMap::ControlMap(ModulationScheduler &modulation, const AnalogConditioner *controls,
+					   uint8_t controlCount) noexcept
+	: modulation(modulation), controls(controls),
+	  controlCount(controlCount < MAX_CONTROLS ? controlCount : MAX_CONTROLS),
+	  table(nullptr), count(0), overrides(), byControl(), bySwitch(),
+	  evalCount(0), echo(nullptr)
+{
+	for (int8_t &s: streams) {
+		s = -1;
+	}
+}
+
+const ControlMap::Mapping *ControlMap::entry(uint8_t index) const noexcept
+{
+	if (index >= count) {
+		return nullptr;
+	}
+	for (const Override &o: overrides) {
+		if (o.used && o.index == index) {
+			return &o.mapping;
+		}
+	}
+	return &table[index];
+}
+
+bool ControlMap::attachStream(uint8_t index) noexcept
+{
+	modulation.removeStream(streams[index]);
+	const Mapping *m = entry(index);
+	const ModulationScheduler::StreamConfig config = {
+		m->id, m->subid, m->outMax, m->rateHz, 2, m->priority,
+		ModulationScheduler::Policy::MERGE
+	};
+	streams[index] = modulation.addStream(config);
+	return streams[index] >= 0;
+}
+
+void ControlMap::rebuildIndex() noexcept
+{
+	for (uint32_t &mask: byControl) {
+		mask = 0;
+	}
+	for (uint32_t &mask: bySwitch) {
+		mask = 0;
+	}
+	for (uint8_t i = 0; i < count; i++) {
+		const Mapping *m = entry(i);
+		if (m->control < controlCount) {
+			byControl[m->control] |= 1UL << i;
+		}
+		for (uint8_t sw = 0; sw < MAX_SWITCHES; sw++) {
+			if (m->modifiers & (1U << sw)) {
+				bySwitch[sw] |= 1UL << i;
+			}
+		}
+	}
+}
+
+uint8_t ControlMap::begin(const Mapping *mappings, uint8_t size) noexcept
+{
+	for (uint8_t i = 0; i < count; i++) {
+		modulation.removeStream(streams[i]);
+		streams[i] = -1;
+	}
+	for (Override &o: overrides) {
+		o.used = false;
+	}
+	table = mappings;
+	count = (size < MAX_MAPPINGS) ? size : MAX_MAPPINGS;
+	evalCount = 0;
+
+	uint8_t attached = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		if (attachStream(i)) {
+			attached++;
+		}
+	}
+	rebuildIndex();
+	return attached;
+}
+
+void ControlMap::send(uint8_t index, uint16_t value) noexcept
+{
+	const Mapping *m = entry(index);
+	if (echo != nullptr && m->name != nullptr) {
+		echo->log(BinLog::PARAM, m->name, value);
+	}
+	modulation.update(streams[index], value);
+}
+
+void ControlMap::evaluate(uint8_t index, uint16_t held) noexcept
+{
+	const Mapping *m = entry(index);
+	evalCount++;
+	if ((held & m->modifiers) != m->modifiers) {
+		return;
+	}
+	if (m->control == NO_CONTROL) {
+		send(index, m->outMax);
+		return;
+	}
+	if (m->control >= controlCount) {
+		return;
+	}
+	// Same scaling as NTS1::Param::scale(), on the shaped value
+	const uint16_t v10 = ResponseCurve::apply(m->curve, controls[m->control].value());
+	const uint32_t span = (uint32_t)(m->outMax - m->outMin) + 1U;
+	send(index, m->outMin + (uint16_t)((v10 * span) >> 10));
+}
+
+void ControlMap::controlChanged(uint8_t control, uint16_t held) noexcept
+{
+	if (control >= controlCount) {
+		return;
+	}
+	for (uint32_t mask = byControl[control]; mask != 0; mask &= mask - 1) {
+		evaluate((uint8_t)__builtin_ctz(mask), held);
+	}
+}
+
+void ControlMap::switchesChanged(uint16_t held, uint16_t pressed, uint16_t released) noexcept
+{
+	uint32_t touched = 0;
+	uint32_t dropped = 0;
+	for (uint8_t sw = 0; sw < MAX_SWITCHES; sw++) {
+		if (pressed & (1U << sw)) {
+			touched |= bySwitch[sw];
+		}
+		if (released & (1U << sw)) {
+			dropped |= bySwitch[sw];
+		}
+	}
+	// A press completes a combination: send the current value once
+	for (uint32_t mask = touched; mask != 0; mask &= mask - 1) {
+		evaluate((uint8_t)__builtin_ctz(mask), held);
+	}
+	// A release ends a switch-only combination that was complete
+	for (uint32_t mask = dropped & ~touched; mask != 0; mask &= mask - 1) {
+		const uint8_t i = (uint8_t)__builtin_ctz(mask);
+		const Mapping *m = entry(i);
+		evalCount++;
+		if (m->control == NO_CONTROL
+			&& ((held | released) & m->modifiers) == m->modifiers
+			&& (held & m->modifiers) != m->modifiers) {
+			send(i, m->outMin);
+		}
+	}
+}
+
+bool ControlMap::setOverride(uint8_t index, const Mapping &mapping) noexcept
+{
+	if (index >= count) {
+		return false;
+	}
+	Override *slot = nullptr;
+	for (Override &o: overrides) {
+		if (o.used && o.index == index) {
+			slot = &o;
+			break;
+		}
+		if (!o.used && slot == nullptr) {
+			slot = &o;
+		}
+	}
+	if (slot == nullptr) {
+		return false;
+	}
+	slot->mapping = mapping;
+	slot->index = index;
+	slot->used = true;
+	attachStream(index);
+	rebuildIndex();
+	return true;
+}
+
+void ControlMap::clearOverride(uint8_t index) noexcept
+{
+	for (Override &o: overrides) {
+		if (o.used && o.index == index) {
+			o.used = false;
+			attachStream(index);
+			rebuildIndex();
+		}
+	}
+}
+
+/* EOF */
@@ -0,0 +1,120 @@
+/** @file ControlMap.hpp
+ *
+ * Declarative mapping of panel controls onto NTS-1 parameters.
+ *
+ * A mapping table, normally a const array in flash, says which source
+ * drives which parameter: a control (ribbon, pot) while a set of
+ * switches is held, or just a switch combination that sends outMax while
+ * held and outMin on release. Each mapping has an output range, a
+ * response curve and a rate limit; the rate limit is a
+ * ModulationScheduler stream, so mapped controls never crowd out notes.
+ *
+ * begin() indexes the table into one bit set per control and per switch.
+ * A control change or switch change then only visits the mappings that
+ * use that source, so the cost follows activity instead of table size.
+ * Single entries can be replaced at runtime by a RAM override without
+ * touching the flash table.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef ControlMap_hpp
+#define ControlMap_hpp
+
+#include <cstdint>
+
+#include "AnalogConditioner.hpp"
+#include "BinLog.hpp"
+#include "ModulationScheduler.hpp"
+#include "ResponseCurve.hpp"
+
+
+class ControlMap {
+public:
+	static const uint8_t MAX_MAPPINGS = ModulationScheduler::MAX_STREAMS;
+	static const uint8_t MAX_CONTROLS = 4;
+	static const uint8_t MAX_SWITCHES = 16;
+	static const uint8_t MAX_OVERRIDES = 2;
+	static const uint8_t NO_CONTROL = 0xFF;	// mapping driven by switches only
+
+	typedef ResponseCurve::Type Curve;
+
+	struct Mapping {
+		const char *name;		// echoed with every value, may be nullptr
+		uint8_t control;		// control index or NO_CONTROL
+		uint16_t modifiers;		// switches that must all be held
+		uint8_t id;				// NTS-1 parameter
+		uint8_t subid;
+		uint16_t outMin;		// output range in parameter units
+		uint16_t outMax;
+		Curve curve;
+		uint16_t rateHz;		// most updates per second
+		ModulationScheduler::Priority priority;
+	};
+
+	/** Mapping for a typed NTS1 parameter, over its full range by default */
+	template <class P>
+	static constexpr Mapping map(const char *name, uint8_t control, uint16_t modifiers,
+								 uint16_t rateHz,
+								 ModulationScheduler::Priority priority = ModulationScheduler::Priority::NORMAL,
+								 Curve curve = Curve::LINEAR,
+								 uint16_t outMin = P::min, uint16_t outMax = P::max) {
+		return Mapping { name, control, modifiers, P::id, P::subid,
+						 outMin, outMax, curve, rateHz, priority };
+	}
+
+	ControlMap(ModulationScheduler &modulation, const AnalogConditioner *controls,
+			   uint8_t controlCount) noexcept;
+
+	/**
+	 * Use a mapping table, which must outlive the map. Returns the number
+	 * of mappings that got a modulation stream.
+	 */
+	uint8_t begin(const Mapping *table, uint8_t count) noexcept;
+
+	/** A conditioned control moved */
+	void controlChanged(uint8_t control, uint16_t held) noexcept;
+
+	/** Switches went down (pressed) or up (released) */
+	void switchesChanged(uint16_t held, uint16_t pressed, uint16_t released) noexcept;
+
+	/** Replace entry index with a RAM copy, false when no slot is free */
+	bool setOverride(uint8_t index, const Mapping &mapping) noexcept;
+
+	/** Go back to the table entry */
+	void clearOverride(uint8_t index) noexcept;
+
+	const Mapping *entry(uint8_t index) const noexcept;
+	uint8_t size() const noexcept { return count; }
+
+	/** Log "name: value" for every value sent, nullptr turns it off */
+	void setEcho(BinLog *log) noexcept { echo = log; }
+
+	/** Mapping evaluations since begin(), for checking the indexing */
+	uint32_t evaluations() const noexcept { return evalCount; }
+
+private:
+	struct Override {
+		Mapping mapping;
+		uint8_t index;
+		bool used;
+	};
+
+	void rebuildIndex() noexcept;
+	bool attachStream(uint8_t index) noexcept;
+	void send(uint8_t index, uint16_t value) noexcept;
+	void evaluate(uint8_t index, uint16_t held) noexcept;
+
+	ModulationScheduler &modulation;
+	const AnalogConditioner *controls;
+	uint8_t controlCount;
+	const Mapping *table;
+	uint8_t count;
+	Override overrides[MAX_OVERRIDES];
+	int8_t streams[MAX_MAPPINGS];
+	uint32_t byControl[MAX_CONTROLS];	// bit n: mapping n uses the control
+	uint32_t bySwitch[MAX_SWITCHES];	// bit n: mapping n has the modifier
+	uint32_t evalCount;
+	BinLog *echo;
+};
+
+#endif /* ControlMap_hpp */
@@ -0,0 +1,166 @@
+/** @file LedDriver.cpp
+ *
+ * Framebuffer driver for the eight panel LEDs with brightness levels.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "LedDriver.hpp"
+
+
+LedFrame::LedFrame(const Pin *pins) noexcept
+	: pins(pins), levels(), changed(true), planes()
+{
+	build();
+}
+
+void LedFrame::set(uint8_t led, uint8_t level) noexcept
+{
+	if (led >= LEDS) {
+		return;
+	}
+	levels[led] = (level > MAX_LEVEL) ? MAX_LEVEL : level;
+	changed = true;		// after the level, the interrupt clears it first
+}
+
+void LedFrame::write(uint8_t mask) noexcept
+{
+	for (uint8_t led = 0; led < LEDS; led++) {
+		levels[led] = ((mask >> led) & 1U) ? MAX_LEVEL : 0;
+	}
+	changed = true;
+}
+
+bool LedFrame::build() noexcept
+{
+	if (!changed) {
+		return false;
+	}
+	changed = false;
+	uint32_t next[BITS][PORTS] = {};
+	for (uint8_t led = 0; led < LEDS; led++) {
+		const uint8_t level = levels[led];
+		const uint32_t mask = 1UL << pins[led].pin;
+		for (uint8_t b = 0; b < BITS; b++) {
+			next[b][pins[led].port] |= ((level >> b) & 1U) ? mask : mask << 16;
+		}
+	}
+	for (uint8_t b = 0; b < BITS; b++) {
+		for (uint8_t p = 0; p < PORTS; p++) {
+			planes[b][p] = next[b][p];
+		}
+	}
+	return true;
+}
+
+
+#if defined(TARGET_STM32F0)
+
+#include "stm32f0xx_hal.h"
+
+// TIM14 is not used by mbed on this target
+#define LED_TIM					TIM14
+#define LED_TIM_IRQn			TIM14_IRQn
+#define LED_TIM_IRQ_PRIORITY	3	// below the NTS-1 link
+#define LED_TIM_IRQ_HANDLER		TIM14_IRQHandler
+
+
+// LED n is bit n of the old BusOut: PC_10, PC_12, PF_6, PF_7, PA_15,
+// PB_7, PC_13, PC_14
+enum { kPortA, kPortB, kPortC, kPortF };
+static const LedFrame::Pin kPins[LedFrame::LEDS] = {
+	{ kPortC, 10 }, { kPortC, 12 }, { kPortF, 6 }, { kPortF, 7 },
+	{ kPortA, 15 }, { kPortB, 7 }, { kPortC, 13 }, { kPortC, 14 },
+};
+static const uint32_t kMaskA = (1U << 15);
+static const uint32_t kMaskB = (1U << 7);
+static const uint32_t kMaskC = (1U << 10) | (1U << 12) | (1U << 13) | (1U << 14);
+static const uint32_t kMaskF = (1U << 6) | (1U << 7);
+
+static LedDriver *sDriver;	// served by the timer interrupt
+
+
+LedDriver::LedDriver(uint32_t slotUs) noexcept
+	: frame(kPins), portA(PortA, kMaskA), portB(PortB, kMaskB),
+	  portC(PortC, kMaskC), portF(PortF, kMaskF), slotUs(slotUs), bit(0),
+	  frameCount(0)
+{
+	// PortOut made the pins outputs, from here on only BSRR is written
+}
+
+LedDriver::~LedDriver()
+{
+	stop();
+}
+
+void LedDriver::show(uint8_t plane) noexcept
+{
+	const uint32_t *words = frame.plane(plane);
+	GPIOA->BSRR = words[kPortA];
+	GPIOB->BSRR = words[kPortB];
+	GPIOC->BSRR = words[kPortC];
+	GPIOF->BSRR = words[kPortF];
+}
+
+void LedDriver::start() noexcept
+{
+	HAL_NVIC_DisableIRQ(LED_TIM_IRQn);
+	frame.build();
+	show(0);
+
+	// 1 MHz count (APB prescaler is 1), ARR preloaded: the value written
+	// in one interrupt is the length of the slot after the next update
+	__HAL_RCC_TIM14_CLK_ENABLE();
+	LED_TIM->CR1 = TIM_CR1_ARPE;
+	LED_TIM->PSC = SystemCoreClock / 1000000U - 1U;
+	LED_TIM->ARR = slotUs - 1U;
+	LED_TIM->EGR = TIM_EGR_UG;
+	LED_TIM->ARR = (slotUs << 1) - 1U;
+	LED_TIM->SR = 0;
+	LED_TIM->DIER = TIM_DIER_UIE;
+	bit = 1;
+
+	sDriver = this;
+	HAL_NVIC_SetPriority(LED_TIM_IRQn, LED_TIM_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(LED_TIM_IRQn);
+	LED_TIM->CR1 |= TIM_CR1_CEN;
+}
+
+void LedDriver::stop() noexcept
+{
+	if (sDriver == this) {
+		HAL_NVIC_DisableIRQ(LED_TIM_IRQn);
+		LED_TIM->CR1 = 0;
+		LED_TIM->DIER = 0;
+		sDriver = nullptr;
+	}
+	// All LEDs off, the framebuffer stays for the next start()
+	GPIOA->BSRR = kMaskA << 16;
+	GPIOB->BSRR = kMaskB << 16;
+	GPIOC->BSRR = kMaskC << 16;
+	GPIOF->BSRR = kMaskF << 16;
+}
+
+// Start of slot bit: show its plane, queue the length of the next one
+void LedDriver::handleIrq() noexcept
+{
+	LED_TIM->SR = ~TIM_SR_UIF;
+	if (bit == 0) {
+		frame.build();
+		frameCount++;
+	}
+	show(bit);
+	const uint8_t next = (bit + 1) % LedFrame::BITS;
+	LED_TIM->ARR = (slotUs << next) - 1U;
+	bit = next;
+}
+
+extern "C" void LED_TIM_IRQ_HANDLER(void)
+{
+	if (sDriver != nullptr) {
+		sDriver->handleIrq();
+	}
+}
+
+#endif // TARGET_STM32F0
+
+/* EOF */
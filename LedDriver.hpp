@@ -0,0 +1,118 @@
+/** @file LedDriver.hpp
+ *
+ * Framebuffer driver for the eight panel LEDs with brightness levels.
+ *
+ * The main loop only writes brightness values (0..MAX_LEVEL) into an
+ * eight entry framebuffer. A hardware timer (TIM14) interrupt refreshes
+ * the LEDs with binary code modulation: each frame has one slot per
+ * brightness bit, slot n lasting SLOT_US << n, and an LED is on during
+ * the slots of the bits set in its level. At the start of every frame
+ * LedFrame turns a changed framebuffer into one BSRR word per GPIO port
+ * and bit plane, so a slot is four register writes however many LEDs
+ * change, instead of the eight pin writes BusOut needs.
+ *
+ * With 4 bits and 200 us slots a frame takes 3 ms (333 Hz) for 16
+ * levels at four interrupts per frame. The timer interrupt runs at a
+ * lower priority than the NTS-1 link, so it never delays an SPI byte;
+ * the us_ticker interrupt behind mbed's Timeout would.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef LedDriver_hpp
+#define LedDriver_hpp
+
+#include <cstdint>
+
+#if defined(TARGET_LIKE_MBED)
+#include "mbed.h"
+#endif
+
+#ifdef MBED_CONF_APP_LED_BCM_SLOT_US
+#define LED_BCM_SLOT_US MBED_CONF_APP_LED_BCM_SLOT_US
+#else
+#define LED_BCM_SLOT_US 200
+#endif
+
+
+/*
+ * Framebuffer and bit planes, no hardware access. Bit b of a plane word
+ * is BSRR: low half sets pins, high half resets them.
+ */
+class LedFrame {
+public:
+	static const uint8_t LEDS = 8;
+	static const uint8_t BITS = 4;
+	static const uint8_t MAX_LEVEL = (1U << BITS) - 1;
+	static const uint8_t PORTS = 4;
+
+	struct Pin {
+		uint8_t port;	// index into the driver's port table
+		uint8_t pin;	// 0..15
+	};
+
+	/** pins has LEDS entries, LED n is bit n of write() */
+	explicit LedFrame(const Pin *pins) noexcept;
+
+	/** Set one LED's brightness, 0 is off */
+	void set(uint8_t led, uint8_t level) noexcept;
+	uint8_t get(uint8_t led) const noexcept { return levels[led]; }
+
+	/** LEDs of mask fully on, the others off, like BusOut */
+	void write(uint8_t mask) noexcept;
+
+	/** Rebuild the planes if the framebuffer changed, true when it did */
+	bool build() noexcept;
+
+	/** BSRR words of one bit plane, PORTS entries */
+	const uint32_t *plane(uint8_t bit) const noexcept { return planes[bit]; }
+
+private:
+	const Pin *pins;
+	volatile uint8_t levels[LEDS];
+	volatile bool changed;
+	uint32_t planes[BITS][PORTS];
+};
+
+
+#if defined(TARGET_STM32F0)
+
+class LedDriver {
+public:
+	explicit LedDriver(uint32_t slotUs = LED_BCM_SLOT_US) noexcept;
+	~LedDriver();
+
+	void start() noexcept;
+	void stop() noexcept;
+
+	void set(uint8_t led, uint8_t level) noexcept { frame.set(led, level); }
+	uint8_t get(uint8_t led) const noexcept { return frame.get(led); }
+	void write(uint8_t mask) noexcept { frame.write(mask); }
+
+	/** Drop-in for the BusOut it replaces */
+	LedDriver &operator=(uint8_t mask) noexcept {
+		write(mask);
+		return *this;
+	}
+
+	/** Frames shown since start(), wraps around */
+	uint32_t frames() const noexcept { return frameCount; }
+
+	/** Called from the timer interrupt handler only */
+	void handleIrq() noexcept;
+
+private:
+	void show(uint8_t plane) noexcept;
+
+	LedFrame frame;
+	PortOut portA;
+	PortOut portB;
+	PortOut portC;
+	PortOut portF;
+	uint32_t slotUs;
+	uint8_t bit;			// plane shown next
+	volatile uint32_t frameCount;
+};
+
+#endif // TARGET_STM32F0
+
+#endif /* LedDriver_hpp */
@@ -0,0 +1,343 @@
+/** @file LinkSim.cpp
+ *
+ * Host side simulation of the NTS-1 main board link with fault injection.
+ *
+ * Frame k is a parameter change for param ID (k % NUM_PARAM_ID) with value
+ * k, so every delivered frame identifies itself and any corruption shows
+ * up as an ID/value mismatch.
+ *
+ * @license: BSD 3-Clause License
+ */
+#if !defined(TARGET_LIKE_MBED)
+
+#include "LinkSim.hpp"
+#include "nts1_port.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+
+// Param change to panel ID 7: [1][0][111][101]
+static const uint8_t kParamStatus = 0xBD;
+static const uint32_t kMaxFrames = 0x4000;	// value is 14 bits
+
+
+LinkSim::LinkSim(NTS1 &nts1) : nts1(nts1), cfg(nullptr), rng(1),
+	bytesSinceIdle(0), stallLeft(0), ignoreAck(false), corrupted(0)
+{
+	nts1.subscribe(&LinkSim::OnParamChange, this);
+}
+
+LinkSim::~LinkSim()
+{
+	nts1.unsubscribe(&LinkSim::OnParamChange, this);
+}
+
+void LinkSim::OnParamChange(void *ctx, const nts1_rx_param_change_t *param)
+{
+	LinkSim *sim = static_cast<LinkSim *>(ctx);
+	const uint32_t value = ((uint32_t)param->msb << 7) | param->lsb;
+	if (value < sim->seen.size()
+		&& param->param_id == value % NTS1::NUM_PARAM_ID
+		&& param->param_subid == 0
+		&& sim->seen[value] == 0) {
+		sim->seen[value] = 1;
+		sim->deliveredUs[value] = nts1_port_timestamp(sim->nts1.port());
+	} else {
+		sim->corrupted++;
+	}
+}
+
+uint32_t LinkSim::random()
+{
+	// xorshift32, deterministic per seed
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+void LinkSim::serviceIdle()
+{
+	nts1_port_host_advance_us(nts1.port(), cfg->byteTimeUs);
+	if (stallLeft > 0) {
+		stallLeft--;
+		return;
+	}
+	if (++bytesSinceIdle >= cfg->idleEveryBytes) {
+		bytesSinceIdle = 0;
+		nts1.idle();
+	}
+}
+
+void LinkSim::sendByte(uint8_t data, bool honorAck)
+{
+	while (honorAck && !nts1_port_host_ack(nts1.port())) {
+		serviceIdle();	// main board waits, time passes
+	}
+	nts1_port_host_transfer(nts1.port(), data);
+	serviceIdle();
+}
+
+LinkSim::Report LinkSim::run(Fault fault, const Config &config)
+{
+	cfg = &config;
+	rng = config.seed ? config.seed : 1;
+	bytesSinceIdle = 0;
+	stallLeft = 0;
+	ignoreAck = false;
+	corrupted = 0;
+
+	const uint32_t frames = (config.frames < kMaxFrames) ? config.frames : kMaxFrames;
+	seen.assign(frames, 0);
+	deliveredUs.assign(frames, 0);
+	std::vector<uint32_t> faultFrames;
+	std::vector<uint32_t> faultUs;
+
+	nts1_port_host_use_sim_clock(nts1.port(), true);
+	nts1.init();
+	nts1.resetBufStats();
+
+	Report report = {};
+	report.fault = fault;
+
+	for (uint32_t k = 0; k < frames; k++) {
+		uint8_t frame[5] = {
+			kParamStatus,
+			(uint8_t)(k % NTS1::NUM_PARAM_ID),
+			0,
+			(uint8_t)((k >> 7) & 0x7F),
+			(uint8_t)(k & 0x7F),
+		};
+		uint8_t len = sizeof(frame);
+		int dropAt = -1;
+
+		if (fault != Fault::NONE && k > 0 && (k % config.faultEvery) == 0) {
+			faultFrames.push_back(k);
+			faultUs.push_back(nts1_port_timestamp(nts1.port()));
+			report.injected++;
+			switch (fault) {
+			case Fault::DROP_BYTE:
+				dropAt = random() % len;
+				break;
+			case Fault::BIT_FLIP:
+				frame[random() % len] ^= (uint8_t)(1U << (random() % 8));
+				break;
+			case Fault::TRUNCATE:
+				len = 1 + random() % (len - 1);
+				break;
+			case Fault::ACK_STALL:
+				stallLeft = config.stallBytes;
+				ignoreAck = false;
+				break;
+			case Fault::OVERLOAD:
+				stallLeft = config.stallBytes;
+				ignoreAck = true;
+				break;
+			default:
+				break;
+			}
+		}
+
+		for (uint8_t i = 0; i < len; i++) {
+			if (i != dropAt) {
+				sendByte(frame[i], !(ignoreAck && stallLeft > 0));
+			}
+		}
+	}
+
+	// Let the panel drain what is left
+	for (uint32_t i = 0; i < config.idleEveryBytes; i++) {
+		sendByte(0xBF, true);	// dummy command
+	}
+	nts1.idle();
+
+	report.sent = frames;
+	report.corrupted = corrupted;
+	for (uint32_t k = 0; k < frames; k++) {
+		if (seen[k]) {
+			report.delivered++;
+		}
+	}
+	report.lost = frames - report.delivered;
+
+	// Recovery: fault to delivery of the next intact frame. Stall faults
+	// do not damage the frame they were injected before.
+	uint64_t recoverySum = 0;
+	uint32_t recovered = 0;
+	const bool stall = (fault == Fault::ACK_STALL || fault == Fault::OVERLOAD);
+	for (size_t i = 0; i < faultFrames.size(); i++) {
+		for (uint32_t j = faultFrames[i] + (stall ? 0 : 1); j < frames; j++) {
+			if (seen[j]) {
+				const uint32_t us = deliveredUs[j] - faultUs[i];
+				recoverySum += us;
+				recovered++;
+				if (us > report.recoveryMaxUs) {
+					report.recoveryMaxUs = us;
+				}
+				break;
+			}
+		}
+	}
+	report.recoveryMeanUs = recovered ? (uint32_t)(recoverySum / recovered) : 0;
+
+	nts1_buf_stats_t bufStats;
+	nts1.getBufStats(&bufStats);
+	report.rxHighWater = bufStats.rx_high_water;
+	report.rxOverflows = bufStats.rx_overflows;
+
+	nts1_port_host_use_sim_clock(nts1.port(), false);
+	cfg = nullptr;
+	return report;
+}
+
+void LinkSim::runCampaign(const Config &config)
+{
+	static const Fault faults[] = {
+		Fault::NONE, Fault::DROP_BYTE, Fault::BIT_FLIP,
+		Fault::TRUNCATE, Fault::ACK_STALL, Fault::OVERLOAD,
+	};
+	printf("%-10s %8s %8s %9s %9s %6s %9s %12s %12s %6s %5s\n",
+		   "fault", "injected", "sent", "delivered", "corrupted",
+		   "lost", "lost/flt", "recov avg us", "recov max us",
+		   "rx hwm", "ovf");
+	for (Fault fault: faults) {
+		Print(run(fault, config));
+	}
+}
+
+void LinkSim::runCampaignParallel(const Config &config)
+{
+	static const Fault faults[] = {
+		Fault::NONE, Fault::DROP_BYTE, Fault::BIT_FLIP,
+		Fault::TRUNCATE, Fault::ACK_STALL, Fault::OVERLOAD,
+	};
+	static const size_t count = sizeof(faults) / sizeof(faults[0]);
+	Report reports[count];
+	std::vector<std::thread> threads;
+
+	// Every scenario gets its own link and port, nothing is shared
+	for (size_t i = 0; i < count; i++) {
+		threads.emplace_back([&, i]() {
+			std::unique_ptr<NTS1> nts1(new NTS1());
+			LinkSim sim(*nts1);
+			reports[i] = sim.run(faults[i], config);
+			nts1->teardown();
+		});
+	}
+	for (std::thread &t: threads) {
+		t.join();
+	}
+	printf("%-10s %8s %8s %9s %9s %6s %9s %12s %12s %6s %5s\n",
+		   "fault", "injected", "sent", "delivered", "corrupted",
+		   "lost", "lost/flt", "recov avg us", "recov max us",
+		   "rx hwm", "ovf");
+	for (const Report &report: reports) {
+		Print(report);
+	}
+}
+
+LinkSim::TxStressReport LinkSim::runTxStress(uint8_t producers, uint32_t framesPerProducer)
+{
+	TxStressReport report = {};
+	std::atomic<uint32_t> queued(0);
+	std::atomic<uint8_t> running(producers);
+	std::vector<std::thread> threads;
+
+	nts1_port_host_use_sim_clock(nts1.port(), false);
+	nts1.init();
+
+	// Producer p sends note on (note p, velocity = sequence mod 128)
+	for (uint8_t p = 0; p < producers; p++) {
+		threads.emplace_back([&, p]() {
+			for (uint32_t seq = 0; seq < framesPerProducer; ) {
+				if (nts1.noteOn(p, seq & 0x7F) == NTS1::STATUS_OK) {
+					seq++;
+					queued++;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+			running--;
+		});
+	}
+
+	// Main board: clock bytes and decode [status][event id][note][velo]
+	std::vector<uint32_t> expect(producers, 0);
+	uint8_t frame[3];
+	uint8_t count = 0;
+	bool inEvent = false;
+	uint32_t idleBytes = 0;
+	auto clock = [&]() {
+		const uint8_t data = nts1_port_host_transfer(nts1.port(), 0xBF);
+		if (data & 0x80) {
+			if (inEvent && count > 0) {
+				report.framingErrors++;
+			}
+			inEvent = ((data & 0x87) == 0x84);
+			count = 0;
+			idleBytes = inEvent ? 0 : idleBytes + 1;
+			return;
+		}
+		if (!inEvent) {
+			return;
+		}
+		frame[count++] = data;
+		if (count < 3) {
+			return;
+		}
+		inEvent = false;
+		count = 0;
+		report.received++;
+		const uint8_t p = frame[1];
+		if (frame[0] != k_nts1_tx_event_id_note_on || p >= producers
+			|| frame[2] != (expect[p] & 0x7F)) {
+			report.orderErrors++;
+		}
+		if (p < producers) {
+			expect[p] = frame[2] + 1;
+		}
+	};
+	while (running > 0) {
+		clock();
+	}
+	for (std::thread &t: threads) {
+		t.join();
+	}
+	// Drain until the panel only sends dummies
+	idleBytes = 0;
+	while (idleBytes < 64) {
+		clock();
+	}
+	report.queued = queued;
+	return report;
+}
+
+const char *LinkSim::FaultName(Fault fault)
+{
+	switch (fault) {
+	case Fault::NONE:		return "none";
+	case Fault::DROP_BYTE:	return "drop";
+	case Fault::BIT_FLIP:	return "bitflip";
+	case Fault::TRUNCATE:	return "truncate";
+	case Fault::ACK_STALL:	return "ack-stall";
+	case Fault::OVERLOAD:	return "overload";
+	}
+	return "?";
+}
+
+void LinkSim::Print(const Report &r)
+{
+	const uint32_t perFault100 = r.injected ? (100 * r.lost) / r.injected : 0;
+	printf("%-10s %8u %8u %9u %9u %6u %6u.%02u %12u %12u %6u %5u\n",
+		   FaultName(r.fault), r.injected, r.sent, r.delivered, r.corrupted,
+		   r.lost, perFault100 / 100, perFault100 % 100,
+		   r.recoveryMeanUs, r.recoveryMaxUs,
+		   r.rxHighWater, r.rxOverflows);
+}
+
+#endif // !TARGET_LIKE_MBED
+
+/* EOF */
@@ -0,0 +1,112 @@
+/** @file LinkSim.hpp
+ *
+ * Host side simulation of the NTS-1 main board link with fault injection.
+ *
+ * The simulated main board streams numbered parameter change frames to
+ * the panel through the host transport port, injects one fault every
+ * few frames and checks which frames reach the panel's handlers intact.
+ * This gives numbers for lost frames per fault and recovery time, so
+ * buffer sizes, overflow policy and resync strategy can be compared.
+ *
+ * Only built for the host (TARGET_LIKE_MBED not defined).
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef LinkSim_hpp
+#define LinkSim_hpp
+
+#if !defined(TARGET_LIKE_MBED)
+
+#include <cstdint>
+#include <vector>
+
+#include "nts-1.h"
+
+
+class LinkSim {
+public:
+	enum class Fault {
+		NONE,
+		DROP_BYTE,	// one byte of a frame never arrives
+		BIT_FLIP,	// one bit of a frame is inverted
+		TRUNCATE,	// frame cut short, next frame follows directly
+		ACK_STALL,	// panel loop stalls, main board waits on ACK
+		OVERLOAD,	// panel loop stalls, main board ignores ACK
+	};
+
+	struct Config {
+		uint32_t frames = 16000;	// frames sent per run, max 16384
+		uint32_t faultEvery = 400;	// inject one fault every N frames
+		uint32_t byteTimeUs = 8;	// time per SPI byte on the wire
+		uint32_t idleEveryBytes = 64;	// panel calls idle() this often
+		uint32_t stallBytes = 1024;	// stall length for ACK_STALL/OVERLOAD
+		uint32_t seed = 0x1234567U;
+	};
+
+	struct Report {
+		Fault fault;
+		uint32_t injected;	// faults injected
+		uint32_t sent;		// frames sent by the main board
+		uint32_t delivered;	// frames delivered intact
+		uint32_t corrupted;	// frames delivered with wrong content
+		uint32_t lost;		// frames never delivered
+		uint32_t recoveryMeanUs;	// fault to delivery of next intact frame
+		uint32_t recoveryMaxUs;
+		uint16_t rxHighWater;	// RX ring high-water mark during the run
+		uint32_t rxOverflows;	// RX ring resets during the run
+	};
+
+	LinkSim(NTS1 &nts1);
+	~LinkSim();
+
+	/** Run one fault scenario and return its statistics */
+	Report run(Fault fault, const Config &cfg);
+
+	/** Run every scenario with the same configuration and print a table */
+	void runCampaign(const Config &cfg);
+
+	/**
+	 * Same table as runCampaign(), but every scenario runs on its own
+	 * thread against its own NTS1 instance
+	 */
+	static void runCampaignParallel(const Config &cfg);
+
+	struct TxStressReport {
+		uint32_t queued;	// note on frames accepted by nts1_note_on()
+		uint32_t received;	// frames decoded on the simulated main board
+		uint32_t framingErrors;	// frames cut by another frame's bytes
+		uint32_t orderErrors;	// per producer sequence gaps or reordering
+	};
+
+	/**
+	 * Queue note on frames from several threads at once while the main
+	 * board clocks the link, and check the panel's output stream for
+	 * interleaved or reordered frames.
+	 */
+	TxStressReport runTxStress(uint8_t producers, uint32_t framesPerProducer);
+
+	static const char *FaultName(Fault fault);
+	static void Print(const Report &report);
+
+private:
+	static void OnParamChange(void *ctx, const nts1_rx_param_change_t *param);
+
+	void sendByte(uint8_t data, bool honorAck);
+	void serviceIdle();
+	uint32_t random();
+
+	NTS1 &nts1;
+	const Config *cfg;
+	uint32_t rng;
+	uint32_t bytesSinceIdle;
+	uint32_t stallLeft;
+	bool ignoreAck;
+
+	std::vector<uint8_t> seen;	// per frame: 0 = not seen, 1 = intact
+	std::vector<uint32_t> deliveredUs;
+	uint32_t corrupted;
+};
+
+#endif // !TARGET_LIKE_MBED
+
+#endif /* LinkSim_hpp */
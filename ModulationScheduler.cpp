@@ -0,0 +1,195 @@
+/** @file ModulationScheduler.cpp
+ *
+ * Token bucket scheduler for continuous parameter modulation streams.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "ModulationScheduler.hpp"
+#include "nts1_port.h"
+
+#include <cstdio>
+
+
+ModulationScheduler::ModulationScheduler(NTS1 &nts1, uint32_t ceilingBps,
+										 uint32_t noteHeadroomBps) noexcept
+	: nts1(nts1), modBps(ceilingBps > noteHeadroomBps ? ceilingBps - noteHeadroomBps : 0),
+	  globalTokens(0), lastUs(0), windowStartUs(0), rrNext(), started(false)
+{
+	for (Stream &s: streams) {
+		s.used = false;
+		s.pending = false;
+	}
+}
+
+int8_t ModulationScheduler::addStream(const StreamConfig &config) noexcept
+{
+	if (config.rateHz == 0 || config.burst == 0
+		|| config.priority >= Priority::COUNT) {
+		return -1;
+	}
+	for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+		Stream &s = streams[i];
+		if (s.used) {
+			continue;
+		}
+		s.config = config;
+		s.stats = StreamStats();
+		s.tokens = (uint32_t)config.burst * TOKEN;	// start full
+		s.windowSent = 0;
+		s.value = 0;
+		s.pending = false;
+		s.used = true;
+		return (int8_t)i;
+	}
+	return -1;
+}
+
+void ModulationScheduler::removeStream(int8_t stream) noexcept
+{
+	if (stream >= 0 && stream < MAX_STREAMS) {
+		const uint32_t state = nts1_port_critical_enter(nts1.port());
+		streams[stream].used = false;
+		streams[stream].pending = false;
+		nts1_port_critical_exit(nts1.port(), state);
+	}
+}
+
+void ModulationScheduler::update(int8_t stream, uint16_t value) noexcept
+{
+	if (stream < 0 || stream >= MAX_STREAMS || !streams[stream].used) {
+		return;
+	}
+	Stream &s = streams[stream];
+	if (value > s.config.max) {
+		value = s.config.max;
+	}
+	const uint32_t state = nts1_port_critical_enter(nts1.port());
+	s.stats.requested++;
+	if (s.config.policy == Policy::DROP && s.tokens < TOKEN) {
+		s.stats.dropped++;
+	} else {
+		if (s.pending) {
+			s.stats.merged++;
+		}
+		s.value = value;
+		s.pending = true;
+	}
+	nts1_port_critical_exit(nts1.port(), state);
+}
+
+bool ModulationScheduler::sendPending(Stream &s) noexcept
+{
+	const uint32_t frameTokens = (uint32_t)FRAME_BYTES * TOKEN;
+	if (s.tokens < TOKEN || globalTokens < frameTokens) {
+		return false;
+	}
+	if (nts1.txFree() < FRAME_BYTES + NOTE_RESERVE_BYTES) {
+		return false;
+	}
+	const uint32_t state = nts1_port_critical_enter(nts1.port());
+	const uint16_t value = s.value;
+	s.pending = false;
+	nts1_port_critical_exit(nts1.port(), state);
+	if (nts1.paramChange(s.config.id, s.config.subid, value) != NTS1::STATUS_OK) {
+		// Lost link or full ring: keep the value unless a newer one came in
+		const uint32_t again = nts1_port_critical_enter(nts1.port());
+		if (!s.pending) {
+			s.value = value;
+			s.pending = true;
+		}
+		nts1_port_critical_exit(nts1.port(), again);
+		return false;
+	}
+	s.tokens -= TOKEN;
+	globalTokens -= frameTokens;
+	s.stats.sent++;
+	s.windowSent++;
+	return true;
+}
+
+void ModulationScheduler::service(uint32_t nowUs) noexcept
+{
+	if (!started) {
+		started = true;
+		lastUs = windowStartUs = nowUs;
+	}
+	uint32_t elapsed = nowUs - lastUs;
+	lastUs = nowUs;
+	if (elapsed > MAX_ELAPSED_US) {
+		elapsed = MAX_ELAPSED_US;
+	}
+
+	// Global bucket holds a few frames so streams due at the same time
+	// can go out together
+	const uint32_t globalMax = 4UL * FRAME_BYTES * TOKEN;
+	const uint64_t global = globalTokens + (uint64_t)modBps * elapsed;
+	globalTokens = (global > globalMax) ? globalMax : (uint32_t)global;
+	for (Stream &s: streams) {
+		if (!s.used) {
+			continue;
+		}
+		const uint32_t max = (uint32_t)s.config.burst * TOKEN;
+		const uint64_t tokens = s.tokens + (uint64_t)s.config.rateHz * elapsed;
+		s.tokens = (tokens > max) ? max : (uint32_t)tokens;
+	}
+
+	// Highest priority first, round robin inside a priority so one busy
+	// stream cannot starve its peers
+	for (uint8_t prio = 0; prio < (uint8_t)Priority::COUNT; prio++) {
+		const uint8_t first = rrNext[prio];
+		for (uint8_t n = 0; n < MAX_STREAMS; n++) {
+			const uint8_t i = (first + n) % MAX_STREAMS;
+			Stream &s = streams[i];
+			if (!s.used || !s.pending || (uint8_t)s.config.priority != prio) {
+				continue;
+			}
+			if (sendPending(s)) {
+				rrNext[prio] = (i + 1) % MAX_STREAMS;
+			}
+			if (globalTokens < (uint32_t)FRAME_BYTES * TOKEN) {
+				break;
+			}
+		}
+	}
+
+	if (nowUs - windowStartUs >= 1000000UL) {
+		windowStartUs = nowUs;
+		for (Stream &s: streams) {
+			s.stats.achievedHz = (s.windowSent > 0xFFFF) ? 0xFFFF : (uint16_t)s.windowSent;
+			s.windowSent = 0;
+		}
+	}
+}
+
+void ModulationScheduler::getStats(int8_t stream, StreamStats *stats) const noexcept
+{
+	if (stream >= 0 && stream < MAX_STREAMS && stats != nullptr) {
+		*stats = streams[stream].stats;
+	}
+}
+
+void ModulationScheduler::resetStats() noexcept
+{
+	for (Stream &s: streams) {
+		s.stats = StreamStats();
+		s.windowSent = 0;
+	}
+}
+
+void ModulationScheduler::printReport() const noexcept
+{
+	printf("mod budget %lu B/s\r\n", (unsigned long)modBps);
+	for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+		const Stream &s = streams[i];
+		if (!s.used) {
+			continue;
+		}
+		printf("mod %u param %u/%u prio %u rate %u/%u Hz req %lu sent %lu merged %lu dropped %lu\r\n",
+			   i, s.config.id, s.config.subid, (unsigned)s.config.priority,
+			   s.stats.achievedHz, s.config.rateHz,
+			   (unsigned long)s.stats.requested, (unsigned long)s.stats.sent,
+			   (unsigned long)s.stats.merged, (unsigned long)s.stats.dropped);
+	}
+}
+
+/* EOF */
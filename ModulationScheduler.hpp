@@ -0,0 +1,141 @@
+/** @file ModulationScheduler.hpp
+ *
+ * Bandwidth scheduler for continuous parameter modulation (ribbon, pots,
+ * software LFOs) towards the NTS-1 main board.
+ *
+ * Every stream is one parameter with a token bucket (update rate and
+ * burst) and a priority. Sources call update() as often as they like;
+ * only the newest value is kept (merge) or, for DROP streams, updates
+ * arriving without a token are discarded. service() sends pending values
+ * in priority order, round robin within a priority, while both the
+ * stream's bucket and a global byte bucket allow it. The global rate is
+ * the link ceiling minus a headroom reserved for note events, and
+ * modulation also leaves a few bytes free in the TX ring, so notes are
+ * never queued behind a burst of parameter changes.
+ *
+ * A scheduler feeds exactly one NTS1 link.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef ModulationScheduler_hpp
+#define ModulationScheduler_hpp
+
+#include <cstdint>
+
+#include "nts-1.h"
+
+// Total link budget in bytes per second and the part kept for notes
+#ifdef MBED_CONF_APP_NTS1_MOD_CEILING_BPS
+#define MOD_CEILING_BPS MBED_CONF_APP_NTS1_MOD_CEILING_BPS
+#else
+#define MOD_CEILING_BPS 4000
+#endif
+#ifdef MBED_CONF_APP_NTS1_NOTE_HEADROOM_BPS
+#define MOD_NOTE_HEADROOM_BPS MBED_CONF_APP_NTS1_NOTE_HEADROOM_BPS
+#else
+#define MOD_NOTE_HEADROOM_BPS 800
+#endif
+
+
+class ModulationScheduler {
+public:
+	static const uint8_t MAX_STREAMS = 8;
+	static const uint8_t FRAME_BYTES = 5;	// param change frame on the wire
+	static const uint8_t NOTE_RESERVE_BYTES = 16;	// TX ring bytes kept free for notes
+
+	enum class Priority : uint8_t {
+		HIGH = 0,
+		NORMAL,
+		LOW,
+		COUNT
+	};
+
+	enum class Policy : uint8_t {
+		MERGE,	// keep the newest value until a token is available
+		DROP,	// discard updates that arrive without a token
+	};
+
+	struct StreamConfig {
+		uint8_t id;
+		uint8_t subid;
+		uint16_t max;		// values are clamped to 0..max
+		uint16_t rateHz;	// sustained updates per second
+		uint8_t burst;		// updates that may go out back to back
+		Priority priority;
+		Policy policy;
+	};
+
+	struct StreamStats {
+		uint32_t requested;	// update() calls
+		uint32_t sent;		// param changes queued to the link
+		uint32_t merged;	// pending values replaced before they were sent
+		uint32_t dropped;	// updates discarded (DROP policy, no token)
+		uint16_t achievedHz;	// sent in the last full one second window
+	};
+
+	ModulationScheduler(NTS1 &nts1, uint32_t ceilingBps = MOD_CEILING_BPS,
+						uint32_t noteHeadroomBps = MOD_NOTE_HEADROOM_BPS) noexcept;
+
+	/**
+	 * Add a stream, returns its handle or -1 when all slots are used
+	 */
+	int8_t addStream(const StreamConfig &config) noexcept;
+
+	/**
+	 * Add a stream for a typed NTS1 parameter
+	 */
+	template <class P>
+	int8_t addStream(uint16_t rateHz, Priority priority = Priority::NORMAL,
+					 uint8_t burst = 2, Policy policy = Policy::MERGE) noexcept {
+		StreamConfig config = { P::id, P::subid, P::max, rateHz, burst, priority, policy };
+		return addStream(config);
+	}
+
+	void removeStream(int8_t stream) noexcept;
+
+	/**
+	 * Offer a new value for a stream, cheap enough to call from a ticker
+	 */
+	void update(int8_t stream, uint16_t value) noexcept;
+
+	/**
+	 * Refill buckets and send what the budget allows; call from the main
+	 * loop with a free running microsecond timestamp
+	 */
+	void service(uint32_t nowUs) noexcept;
+
+	void getStats(int8_t stream, StreamStats *stats) const noexcept;
+	void resetStats() noexcept;
+
+	/** Print one line per stream: configured vs achieved rate and counters */
+	void printReport() const noexcept;
+
+private:
+	// Tokens are kept in millionths so rate (per second) times elapsed
+	// microseconds adds up without division
+	static const uint32_t TOKEN = 1000000UL;
+	static const uint32_t MAX_ELAPSED_US = 100000UL;
+
+	struct Stream {
+		StreamConfig config;
+		StreamStats stats;
+		uint32_t tokens;
+		uint32_t windowSent;
+		uint16_t value;
+		bool used;
+		bool pending;
+	};
+
+	bool sendPending(Stream &s) noexcept;
+
+	NTS1 &nts1;
+	Stream streams[MAX_STREAMS];
+	uint32_t modBps;		// ceiling minus note headroom
+	uint32_t globalTokens;	// bytes * TOKEN
+	uint32_t lastUs;
+	uint32_t windowStartUs;
+	uint8_t rrNext[(uint8_t)Priority::COUNT];
+	bool started;
+};
+
+#endif /* ModulationScheduler_hpp */
@@ -0,0 +1,120 @@
+/** @file NTS1Script.cpp
+ *
+ * Protothread scripts talking to the NTS-1 main board.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "NTS1Script.hpp"
+
+
+NTS1Script::NTS1Script(NTS1 &nts1) noexcept
+	: nts1(nts1), runner(nullptr), stepMark(0), reply(0),
+	  replyPending(false), replyOk(false)
+{
+}
+
+void NTS1Script::OnValue(void *ctx, const nts1_rx_value_t *value)
+{
+	NTS1Script *script = static_cast<NTS1Script *>(ctx);
+	script->replyPending = false;
+	script->replyOk = (value != nullptr);
+	if (value != nullptr) {
+		script->reply = value->value;
+	}
+}
+
+bool NTS1Script::request(uint8_t id, uint8_t subid) noexcept
+{
+	if (replyPending) {
+		return false;	// one outstanding request per script
+	}
+	if (nts1.reqParamValue(id, subid, &NTS1Script::OnValue, this) != NTS1::STATUS_OK) {
+		return false;
+	}
+	replyOk = false;
+	replyPending = true;
+	return true;
+}
+
+void NTS1Script::markSteps() noexcept
+{
+	stepMark = (runner != nullptr) ? runner->stepTicks() : 0;
+}
+
+uint16_t NTS1Script::stepsSinceMark() const noexcept
+{
+	return (runner != nullptr) ? (uint16_t)(runner->stepTicks() - stepMark) : 0;
+}
+
+// ----------------------------------------------------------
+
+ScriptRunner::ScriptRunner(NTS1 &nts1) noexcept : nts1(nts1), scripts(), ticks(0)
+{
+	nts1.subscribe(&ScriptRunner::OnStepTick, this);
+}
+
+ScriptRunner::~ScriptRunner()
+{
+	nts1.unsubscribe(&ScriptRunner::OnStepTick, this);
+}
+
+void ScriptRunner::OnStepTick(void *ctx)
+{
+	static_cast<ScriptRunner *>(ctx)->ticks++;
+}
+
+bool ScriptRunner::start(NTS1Script &script) noexcept
+{
+	NTS1Script **slot = nullptr;
+	for (NTS1Script *&s: scripts) {
+		if (s == &script) {
+			slot = &s;
+			break;
+		}
+		if (s == nullptr && slot == nullptr) {
+			slot = &s;
+		}
+	}
+	if (slot == nullptr) {
+		return false;
+	}
+	script.runner = this;
+	script.restart();
+	*slot = &script;
+	return true;
+}
+
+void ScriptRunner::stop(NTS1Script &script) noexcept
+{
+	for (NTS1Script *&s: scripts) {
+		if (s == &script) {
+			s = nullptr;
+		}
+	}
+}
+
+void ScriptRunner::service() noexcept
+{
+	for (NTS1Script *&s: scripts) {
+		if (s == nullptr) {
+			continue;
+		}
+		// A yielding script gets the CPU back next time round
+		if (s->run() == Protothread::EXITED) {
+			s = nullptr;
+		}
+	}
+}
+
+uint8_t ScriptRunner::running() const noexcept
+{
+	uint8_t count = 0;
+	for (const NTS1Script *s: scripts) {
+		if (s != nullptr) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/* EOF */
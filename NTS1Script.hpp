@@ -0,0 +1,106 @@
+/** @file NTS1Script.hpp
+ *
+ * Protothread scripts talking to the NTS-1 main board.
+ *
+ * An NTS1Script is a protothread (Protothread.hpp) with waits for the
+ * things a configuration sequence needs from the link: free TX space, the
+ * reply to a parameter value request and step ticks. A ScriptRunner runs
+ * its scripts once per service() call from the main loop, so any number
+ * of sequences can progress next to input scanning without blocking it.
+ *
+ * Replies and step ticks are delivered from NTS1::idle(), call it in the
+ * same loop as ScriptRunner::service().
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef NTS1Script_hpp
+#define NTS1Script_hpp
+
+#include <cstdint>
+
+#include "Protothread.hpp"
+#include "nts-1.h"
+
+
+class ScriptRunner;
+
+class NTS1Script : public Protothread {
+public:
+	explicit NTS1Script(NTS1 &nts1) noexcept;
+
+protected:
+	/** True when the TX ring has room for at least the given bytes */
+	bool txReady(uint8_t bytes) noexcept { return nts1.txFree() >= bytes; }
+
+	/**
+	 * Ask for a parameter value, true once the request is on its way.
+	 * Use as PT_WAIT_UNTIL(request(id, subid)); PT_WAIT_UNTIL(replied());
+	 * the script object must stay alive until the reply or its timeout.
+	 */
+	bool request(uint8_t id, uint8_t subid) noexcept;
+
+	template <class P>
+	bool request() noexcept { return request(P::id, P::subid); }
+
+	/** True once the last request got its reply or timed out */
+	bool replied() const noexcept { return !replyPending; }
+
+	/** Reply value, only meaningful when replyValid() */
+	uint16_t replyValue() const noexcept { return reply; }
+	bool replyValid() const noexcept { return replyOk; }
+
+	/** Remember the current step count for stepsSinceMark() */
+	void markSteps() noexcept;
+
+	/** Step ticks from the main board since markSteps() */
+	uint16_t stepsSinceMark() const noexcept;
+
+	NTS1 &nts1;
+
+private:
+	friend class ScriptRunner;
+
+	static void OnValue(void *ctx, const nts1_rx_value_t *value);
+
+	const ScriptRunner *runner;
+	uint16_t stepMark;
+	uint16_t reply;
+	bool replyPending;
+	bool replyOk;
+};
+
+
+class ScriptRunner {
+public:
+	static const uint8_t MAX_SCRIPTS = 4;
+
+	explicit ScriptRunner(NTS1 &nts1) noexcept;
+	~ScriptRunner();
+
+	/**
+	 * Start a script from the beginning, false when all slots are used.
+	 * A script that is already running is restarted.
+	 */
+	bool start(NTS1Script &script) noexcept;
+
+	/** Stop a script without running it to its end */
+	void stop(NTS1Script &script) noexcept;
+
+	/** Run every script until it waits or exits; call from the main loop */
+	void service() noexcept;
+
+	/** Scripts that have not exited yet */
+	uint8_t running() const noexcept;
+
+	/** Step ticks received since construction, wraps around */
+	uint16_t stepTicks() const noexcept { return ticks; }
+
+private:
+	static void OnStepTick(void *ctx);
+
+	NTS1 &nts1;
+	NTS1Script *scripts[MAX_SCRIPTS];
+	uint16_t ticks;
+};
+
+#endif /* NTS1Script_hpp */
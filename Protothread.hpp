@@ -0,0 +1,100 @@
+/** @file Protothread.hpp
+ *
+ * Stackless cooperative tasks (protothreads) for scripted sequences that
+ * have to wait for something without blocking the main loop.
+ *
+ * A protothread is a run() function built from the PT_* macros below. The
+ * macros turn the body into a switch on the line number where it last
+ * stopped, so every call of run() continues right after the last wait.
+ * The only state kept between calls is that line number (two bytes) and
+ * whatever the derived class keeps in its members: local variables do NOT
+ * survive a wait, and PT_* waits cannot be used inside a nested switch.
+ * Conditions may contain commas (template arguments).
+ *
+ *	Status run() noexcept override {
+ *		PT_BEGIN();
+ *		for (i = 0; i < 4; i++) {	// i is a member
+ *			PT_WAIT_UNTIL(nts1.txFree() >= 5);
+ *			...
+ *		}
+ *		PT_END();
+ *	}
+ *
+ * C++20 coroutines would do the same without the macros, but the panel
+ * toolchain is gnu++14.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef Protothread_hpp
+#define Protothread_hpp
+
+#include <cstdint>
+
+
+class Protothread {
+public:
+	enum Status : uint8_t {
+		WAITING = 0,	// blocked on a condition
+		YIELDED,		// gave up the CPU, ready to continue
+		EXITED,			// ran to PT_END() or PT_EXIT()
+	};
+
+	Protothread() noexcept : lc(0) {}
+	virtual ~Protothread() {}
+
+	/** Continue the script until it waits, yields or exits */
+	virtual Status run() noexcept = 0;
+
+	/** Start over from PT_BEGIN() on the next run() */
+	void restart() noexcept { lc = 0; }
+
+	bool done() const noexcept { return lc == LC_DONE; }
+
+protected:
+	static const uint16_t LC_DONE = 0xFFFF;
+
+	uint16_t lc;	// line to continue at, 0 = start
+};
+
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define PT_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define PT_FALLTHROUGH do { } while (0)
+#endif
+
+#define PT_BEGIN()	switch (lc) { case 0:
+
+#define PT_WAIT_UNTIL(...)							\
+	do {											\
+		lc = __LINE__;								\
+		PT_FALLTHROUGH;								\
+	case __LINE__:									\
+		if (!(__VA_ARGS__)) {						\
+			return Protothread::WAITING;			\
+		}											\
+	} while (0)
+
+#define PT_WAIT_WHILE(...)	PT_WAIT_UNTIL(!(__VA_ARGS__))
+
+#define PT_YIELD()									\
+	do {											\
+		lc = __LINE__;								\
+		return Protothread::YIELDED;				\
+	case __LINE__:;									\
+	} while (0)
+
+#define PT_EXIT()									\
+	do {											\
+		lc = Protothread::LC_DONE;					\
+		return Protothread::EXITED;					\
+	} while (0)
+
+#define PT_END()									\
+	default:										\
+		break;										\
+	}												\
+	lc = Protothread::LC_DONE;						\
+	return Protothread::EXITED
+
+#endif /* Protothread_hpp */
@@ -0,0 +1,15 @@
+/** @file ResponseCurve.cpp
+ *
+ * Response curves for 10 bit controls, the tables in flash.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "ResponseCurve.hpp"
+
+
+constexpr ResponseCurveGen::Lut ResponseCurve::EXP_LUT;
+constexpr ResponseCurveGen::LogLut ResponseCurve::LOG_LUT;
+constexpr ResponseCurveGen::Lut ResponseCurve::S_LUT;
+constexpr ResponseCurveGen::StepLut ResponseCurve::STEP_LUT;
+
+/* EOF */
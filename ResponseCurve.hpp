@@ -0,0 +1,208 @@
+/** @file ResponseCurve.hpp
+ *
+ * Response curves for 10 bit controls: exponential, logarithmic, S-curve
+ * and stepped, all 10 bit in and 10 bit out.
+ *
+ * The smooth curves are lookup tables with linear interpolation in
+ * between, so a lookup is a shift, a mask, one multiply and two table
+ * reads. EXP and S use 33 points (32 segments of 32 input steps). LOG
+ * rises steeply at the start, there 32 input steps would be 5% of full
+ * scale off the curve: its first FINE_END inputs use segments of 4 steps,
+ * the rest segments of 32, 61 points in all. Every curve stays within
+ * about 5 LSB of the ideal one. The tables are computed by
+ * constexpr functions while compiling and end up as constants in flash;
+ * no floating point code is linked into the firmware. The stepped curve
+ * is a plain table of STEPS evenly spaced values without interpolation.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef ResponseCurve_hpp
+#define ResponseCurve_hpp
+
+#include <cstdint>
+
+
+/** Compile time table generation, nothing in here runs on the target */
+class ResponseCurveGen {
+public:
+	static const uint16_t MAX = 1023;
+	static const uint8_t SEGMENT_BITS = 5;
+	static const uint8_t POINTS = (1U << (10 - SEGMENT_BITS)) + 1;
+	static const uint8_t STEPS = 8;
+
+	// LOG: FINE_POINTS segments of 1 << FINE_BITS below FINE_END, then
+	// segments of 1 << SEGMENT_BITS up to 1024
+	static const uint16_t FINE_END = 128;
+	static const uint8_t FINE_BITS = 2;
+	static const uint8_t FINE_POINTS = FINE_END >> FINE_BITS;
+	static const uint8_t LOG_POINTS = FINE_POINTS + ((1024 - FINE_END) >> SEGMENT_BITS) + 1;
+
+	// EXP spans about 40 dB: y = (e^(Kx) - 1) / (e^K - 1), LOG is its inverse
+	static constexpr double K = 4.6;
+
+	enum class Shape : uint8_t { EXP, LOG, S };
+
+	struct Lut {
+		uint16_t points[POINTS];
+	};
+
+	struct LogLut {
+		uint16_t points[LOG_POINTS];
+	};
+
+	struct StepLut {
+		uint16_t points[STEPS];
+	};
+
+	static constexpr double exp(double x) {
+		// e^x = (e^(x/1024))^1024, Taylor series for the small argument
+		const double y = x / 1024.0;
+		double term = 1.0;
+		double sum = 1.0;
+		for (int n = 1; n < 8; n++) {
+			term *= y / n;
+			sum += term;
+		}
+		for (int n = 0; n < 10; n++) {
+			sum *= sum;
+		}
+		return sum;
+	}
+
+	static constexpr double log(double x) {
+		// log(x) = n log(2) + log(m) with m in [1, 2), Newton on e^y = m
+		int n = 0;
+		while (x >= 2.0) {
+			x /= 2.0;
+			n++;
+		}
+		double y = x - 1.0;
+		double ln2 = 0.5;
+		for (int i = 0; i < 8; i++) {
+			y -= 1.0 - x / exp(y);
+			ln2 -= 1.0 - 2.0 / exp(ln2);
+		}
+		return n * ln2 + y;
+	}
+
+	static constexpr double shape(Shape s, double x) {
+		return (s == Shape::EXP) ? (exp(K * x) - 1.0) / (exp(K) - 1.0)
+			: (s == Shape::LOG) ? log(1.0 + (exp(K) - 1.0) * x) / K
+			: x * x * (3.0 - 2.0 * x);
+	}
+
+	/** Table value at input x of 1024 */
+	static constexpr uint16_t point(Shape s, uint32_t x) {
+		const double y = shape(s, x / 1024.0) * MAX + 0.5;
+		return (y < 0.0) ? 0 : (y > MAX) ? MAX : (uint16_t)y;
+	}
+
+	static constexpr Lut make(Shape s) {
+		Lut lut = {};
+		for (uint8_t i = 0; i < POINTS; i++) {
+			lut.points[i] = point(s, (uint32_t)i << SEGMENT_BITS);
+		}
+		return lut;
+	}
+
+	static constexpr LogLut makeLog() {
+		LogLut lut = {};
+		for (uint8_t i = 0; i < LOG_POINTS; i++) {
+			lut.points[i] = point(Shape::LOG, (i < FINE_POINTS)
+				? (uint32_t)i << FINE_BITS
+				: FINE_END + ((uint32_t)(i - FINE_POINTS) << SEGMENT_BITS));
+		}
+		return lut;
+	}
+
+	static constexpr StepLut makeSteps() {
+		StepLut lut = {};
+		for (uint8_t i = 0; i < STEPS; i++) {
+			lut.points[i] = (uint16_t)((i * (uint32_t)MAX + (STEPS - 1) / 2) / (STEPS - 1));
+		}
+		return lut;
+	}
+};
+
+
+class ResponseCurve {
+public:
+	enum class Type : uint8_t {
+		LINEAR,
+		EXP,		// slow start: cutoff, times
+		LOG,		// fast start, inverse of EXP
+		S_CURVE,	// fine control around both ends
+		STEPPED,	// STEPS evenly spaced values
+	};
+
+	static const uint16_t MAX = ResponseCurveGen::MAX;
+	static const uint8_t STEPS = ResponseCurveGen::STEPS;
+
+	/** Shape a 10 bit value with the given curve */
+	static inline uint16_t apply(Type type, uint16_t value) noexcept {
+		if (value > MAX) {
+			value = MAX;
+		}
+		switch (type) {
+		case Type::EXP:
+			return interpolate(EXP_LUT.points, value);
+		case Type::LOG:
+			return interpolateLog(value);
+		case Type::S_CURVE:
+			return interpolate(S_LUT.points, value);
+		case Type::STEPPED:
+			return STEP_LUT.points[(value * STEPS) >> 10];
+		case Type::LINEAR:
+		default:
+			return value;
+		}
+	}
+
+	static constexpr ResponseCurveGen::Lut EXP_LUT =
+		ResponseCurveGen::make(ResponseCurveGen::Shape::EXP);
+	static constexpr ResponseCurveGen::LogLut LOG_LUT =
+		ResponseCurveGen::makeLog();
+	static constexpr ResponseCurveGen::Lut S_LUT =
+		ResponseCurveGen::make(ResponseCurveGen::Shape::S);
+	static constexpr ResponseCurveGen::StepLut STEP_LUT =
+		ResponseCurveGen::makeSteps();
+
+private:
+	static const uint8_t SEGMENT_BITS = ResponseCurveGen::SEGMENT_BITS;
+	static const uint8_t POINTS = ResponseCurveGen::POINTS;
+	static const uint16_t FINE_END = ResponseCurveGen::FINE_END;
+	static const uint8_t FINE_BITS = ResponseCurveGen::FINE_BITS;
+	static const uint8_t FINE_POINTS = ResponseCurveGen::FINE_POINTS;
+	static const uint8_t LOG_POINTS = ResponseCurveGen::LOG_POINTS;
+
+	/** Point i plus f / (1 << bits) of the way to point i + 1 */
+	static inline uint16_t segment(const uint16_t *lut, uint8_t i, int32_t f,
+								   uint8_t bits) noexcept {
+		const int32_t a = lut[i];
+		return (uint16_t)(a + (((lut[i + 1] - a) * f) >> bits));
+	}
+
+	static inline uint16_t interpolate(const uint16_t *lut, uint16_t value) noexcept {
+		if (value == MAX) {
+			return lut[POINTS - 1];		// the last segment ends at 1024
+		}
+		return segment(lut, value >> SEGMENT_BITS,
+					   value & ((1U << SEGMENT_BITS) - 1), SEGMENT_BITS);
+	}
+
+	static inline uint16_t interpolateLog(uint16_t value) noexcept {
+		const uint16_t *lut = LOG_LUT.points;
+		if (value == MAX) {
+			return lut[LOG_POINTS - 1];
+		}
+		if (value < FINE_END) {
+			return segment(lut, value >> FINE_BITS,
+						   value & ((1U << FINE_BITS) - 1), FINE_BITS);
+		}
+		value -= FINE_END;
+		return segment(lut, FINE_POINTS + (value >> SEGMENT_BITS),
+					   value & ((1U << SEGMENT_BITS) - 1), SEGMENT_BITS);
+	}
+};
+
+#endif /* ResponseCurve_hpp */
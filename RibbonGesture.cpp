@@ -0,0 +1,142 @@
+/** @file RibbonGesture.cpp
+ *
+ * Gesture recognition for the ribbon, fed from the ADC block stream.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "RibbonGesture.hpp"
+
+
+constexpr RibbonGesture::Config RibbonGesture::DEFAULT_CONFIG;
+
+
+RibbonGesture::RibbonGesture(const Config &config) noexcept
+	: config(config), events(), blockCount(0), idleAcc(0), velAcc(0),
+	  pos(0), slidePos(0), pending(0), settle(0), zoneCount(0),
+	  zone(NO_ZONE), isTouched(false), primed(false), queued(false),
+	  overflowCount(0)
+{
+}
+
+void RibbonGesture::setZones(uint8_t zones) noexcept
+{
+	// The interrupt picks the new split up with the next block
+	zoneCount = (zones > MAX_ZONES) ? MAX_ZONES : zones;
+}
+
+int16_t RibbonGesture::velocity() const noexcept
+{
+	const int32_t v = (velAcc * (int32_t)config.blockHz) >> FRAC;
+	return (int16_t)((v > INT16_MAX) ? INT16_MAX : (v < -INT16_MAX) ? -INT16_MAX : v);
+}
+
+void RibbonGesture::push(Type type, uint8_t zoneIndex) noexcept
+{
+	const Event event = { blockCount, pos, velocity(), type, zoneIndex };
+	if (events.push(event)) {
+		queued = true;
+	} else {
+		overflowCount++;
+	}
+}
+
+uint8_t RibbonGesture::zoneOf(uint16_t position) const noexcept
+{
+	return (uint8_t)(((uint32_t)position * zoneCount) >> 10);
+}
+
+void RibbonGesture::touch(uint16_t position) noexcept
+{
+	isTouched = true;
+	pos = position;
+	pending = position;
+	slidePos = position;
+	velAcc = 0;
+	push(Type::TOUCH);
+	if (zoneCount != 0) {
+		zone = zoneOf(position);
+		push(Type::ZONE_ON, zone);
+	}
+}
+
+void RibbonGesture::move(uint16_t position) noexcept
+{
+	// Positions are applied one block late: the block before a release
+	// averages over the lift-off and is dropped by release()
+	const uint16_t next = pending;
+	pending = position;
+
+	const int32_t delta = (int32_t)next - (int32_t)pos;
+	velAcc += ((delta << FRAC) - velAcc) >> VEL_SHIFT;
+	pos = next;
+
+	const uint16_t travel = (next > slidePos) ? next - slidePos : slidePos - next;
+	if (travel >= config.slideStep) {
+		slidePos = next;
+		push(Type::SLIDE);
+	}
+
+	const uint8_t zc = zoneCount;
+	if (zone != NO_ZONE) {
+		const uint16_t lo = (uint16_t)(((uint32_t)zone << 10) / (zc ? zc : 1));
+		const uint16_t hi = (uint16_t)((((uint32_t)zone + 1) << 10) / (zc ? zc : 1));
+		if (zc != 0 && zone < zc && next + config.zoneHysteresis >= lo
+			&& next < hi + config.zoneHysteresis) {
+			return;		// still in the zone
+		}
+		push(Type::ZONE_OFF, zone);
+		zone = NO_ZONE;
+	}
+	if (zc != 0) {
+		zone = zoneOf(next);
+		push(Type::ZONE_ON, zone);
+	}
+}
+
+void RibbonGesture::release() noexcept
+{
+	if (zone != NO_ZONE) {
+		push(Type::ZONE_OFF, zone);
+		zone = NO_ZONE;
+	}
+	push(Type::RELEASE);
+	isTouched = false;
+	velAcc = 0;
+	settle = 0;
+}
+
+bool RibbonGesture::update(uint16_t raw) noexcept
+{
+	blockCount++;
+	queued = false;
+	if (!primed) {
+		idleAcc = (uint32_t)raw << IDLE_SHIFT;
+		primed = true;
+		return false;
+	}
+
+	const uint16_t idle = idleLevel();
+	const uint16_t dist = (raw > idle) ? raw - idle : idle - raw;
+	const uint16_t position = raw >> 2;
+
+	if (isTouched) {
+		if (dist < config.releaseDelta) {
+			release();
+		} else {
+			move(position);
+		}
+	} else if (dist > config.touchDelta) {
+		// The first block averages over the contact, use a later one
+		if (++settle >= config.settleBlocks) {
+			settle = 0;
+			touch(position);
+		}
+	} else {
+		settle = 0;
+		idleAcc += raw;
+		idleAcc -= idle;
+	}
+	return queued;
+}
+
+/* EOF */
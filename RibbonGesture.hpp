@@ -0,0 +1,117 @@
+/** @file RibbonGesture.hpp
+ *
+ * Gesture recognition for the ribbon, fed from the ADC block stream.
+ *
+ * Every averaged ADC block (about 1.5 kHz) goes through update(). The
+ * ribbon reads an idle level while nobody touches it; the level is learnt
+ * at start and tracked slowly while released. A touch is a reading more
+ * than touchDelta away from it for settleBlocks blocks in a row, the
+ * release a reading back within releaseDelta. The first block of a touch
+ * is an average over the moment of contact and is skipped, so a touch is
+ * reported about 1.3 ms after the finger lands.
+ *
+ * While touched the engine keeps the 10 bit position and a smoothed
+ * velocity in 10 bit units per second and reports a slide every
+ * slideStep units of travel; positions lag one block so the lift-off
+ * block never shows up as a jump. In keyboard mode the ribbon is split into
+ * equal zones; entering and leaving a zone are events too, with some
+ * hysteresis at the zone borders so a finger on a border does not
+ * chatter. Positions within touchDelta of the idle level cannot be told
+ * from no touch, so that end of the ribbon is a dead zone.
+ *
+ * Everything is integer arithmetic. Events go through a lock-free queue,
+ * update() runs in the DMA interrupt and poll() in a task.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef RibbonGesture_hpp
+#define RibbonGesture_hpp
+
+#include <cstdint>
+
+#include "SpscQueue.hpp"
+
+
+class RibbonGesture {
+public:
+	static const uint8_t MAX_ZONES = 16;
+	static const uint8_t QUEUE_SIZE = 16;
+
+	enum class Type : uint8_t {
+		TOUCH,
+		RELEASE,
+		SLIDE,
+		ZONE_ON,	// the finger entered a zone, also on touch
+		ZONE_OFF,	// the finger left a zone, also on release
+	};
+
+	struct Event {
+		uint32_t block;		// update() count when it happened
+		uint16_t position;	// 10 bit
+		int16_t velocity;	// 10 bit units per second, + is up the ribbon
+		Type type;
+		uint8_t zone;		// zone of ZONE_ON and ZONE_OFF
+	};
+
+	struct Config {
+		uint16_t touchDelta;	// 12 bit distance from idle that is a touch
+		uint16_t releaseDelta;	// and that is a release, below touchDelta
+		uint8_t settleBlocks;	// blocks a touch must last before it counts
+		uint16_t slideStep;		// 10 bit travel per SLIDE event
+		uint16_t blockHz;		// update() rate, for the velocity unit
+		uint8_t zoneHysteresis;	// 10 bit units past a zone border
+	};
+
+	/** 1.5 kHz blocks, touch 1.3 ms after contact */
+	static constexpr Config DEFAULT_CONFIG = { 160, 96, 2, 8, 1488, 8 };
+
+	explicit RibbonGesture(const Config &config = DEFAULT_CONFIG) noexcept;
+
+	/** Feed one 12 bit block average, true when events were queued */
+	bool update(uint16_t raw) noexcept;
+
+	/** Take the oldest event, false when there is none */
+	bool poll(Event &event) noexcept { return events.pop(event); }
+
+	/** Split the ribbon into zones for keyboard mode, 0 turns it off */
+	void setZones(uint8_t zones) noexcept;
+	uint8_t zones() const noexcept { return zoneCount; }
+
+	bool touched() const noexcept { return isTouched; }
+	uint16_t position() const noexcept { return pos; }
+	int16_t velocity() const noexcept;
+	uint16_t idleLevel() const noexcept { return (uint16_t)(idleAcc >> IDLE_SHIFT); }
+
+	/** Events dropped because the queue was full */
+	uint32_t overflows() const noexcept { return overflowCount; }
+
+private:
+	static const uint8_t IDLE_SHIFT = 6;	// idle tracking alpha 1/64
+	static const uint8_t VEL_SHIFT = 2;		// velocity smoothing alpha 1/4
+	static const uint8_t FRAC = 8;
+	static const uint8_t NO_ZONE = 0xFF;
+
+	void push(Type type, uint8_t zone = NO_ZONE) noexcept;
+	uint8_t zoneOf(uint16_t position) const noexcept;
+	void touch(uint16_t position) noexcept;
+	void move(uint16_t position) noexcept;
+	void release() noexcept;
+
+	Config config;
+	SpscQueue<Event, QUEUE_SIZE> events;
+	uint32_t blockCount;
+	uint32_t idleAcc;		// idle level << IDLE_SHIFT
+	int32_t velAcc;			// units per block << FRAC
+	volatile uint16_t pos;
+	uint16_t slidePos;		// position of the last SLIDE
+	uint16_t pending;		// latest position, applied with the next block
+	uint8_t settle;			// blocks seen of a touch being confirmed
+	volatile uint8_t zoneCount;
+	uint8_t zone;
+	volatile bool isTouched;
+	bool primed;
+	bool queued;			// events pushed during this update()
+	uint32_t overflowCount;
+};
+
+#endif /* RibbonGesture_hpp */
@@ -0,0 +1,228 @@
+/** @file Scheduler.cpp
+ *
+ * Small cooperative run-to-completion scheduler for the bare-metal panel.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "Scheduler.hpp"
+
+#include <cstdio>
+
+#if defined(TARGET_LIKE_MBED)
+#include "us_ticker_api.h"
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+
+static inline uint32_t sNowUs()
+{
+#if defined(TARGET_LIKE_MBED)
+	// Extended ticker, the raw counter wraps every 65 ms on the F0
+	return (uint32_t)ticker_read_us(get_us_ticker_data());
+#else
+	return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+Scheduler::Scheduler() noexcept : tasks(), ticks(0)
+{
+	for (Task &t: tasks) {
+		t.kind = Kind::FREE;
+		t.pending = false;
+	}
+}
+
+Scheduler::~Scheduler()
+{
+	stop();
+}
+
+int8_t Scheduler::add(Kind kind, const char *name, TaskFn fn, void *ctx,
+					  uint32_t periodMs, uint32_t delayMs, uint32_t deadlineMs) noexcept
+{
+	if (fn == nullptr || (kind == Kind::PERIODIC && periodMs == 0)) {
+		return -1;
+	}
+	for (uint8_t i = 0; i < MAX_TASKS; i++) {
+		Task &t = tasks[i];
+		if (t.kind != Kind::FREE) {
+			continue;
+		}
+		t.name = name;
+		t.fn = fn;
+		t.ctx = ctx;
+		t.periodMs = periodMs;
+		t.deadlineMs = deadlineMs;
+		t.dueMs = ticks + delayMs;
+		t.readyMs = 0;
+		t.stats = TaskStats();
+		t.pending = false;
+		t.kind = kind;	// last, the slot is live from here
+		return (int8_t)i;
+	}
+	return -1;
+}
+
+int8_t Scheduler::addPeriodic(const char *name, TaskFn fn, void *ctx,
+							  uint32_t periodMs, uint32_t deadlineMs) noexcept
+{
+	return add(Kind::PERIODIC, name, fn, ctx, periodMs, periodMs,
+			   deadlineMs ? deadlineMs : periodMs);
+}
+
+int8_t Scheduler::addOneShot(const char *name, TaskFn fn, void *ctx,
+							 uint32_t delayMs, uint32_t deadlineMs) noexcept
+{
+	return add(Kind::ONE_SHOT, name, fn, ctx, 0, delayMs, deadlineMs);
+}
+
+int8_t Scheduler::addEvent(const char *name, TaskFn fn, void *ctx,
+						   uint32_t deadlineMs) noexcept
+{
+	return add(Kind::EVENT, name, fn, ctx, 0, 0, deadlineMs);
+}
+
+void Scheduler::signal(int8_t task) noexcept
+{
+	if (task < 0 || task >= MAX_TASKS || tasks[task].kind != Kind::EVENT) {
+		return;
+	}
+	Task &t = tasks[task];
+	if (!t.pending) {
+		t.readyMs = ticks;
+		t.pending = true;
+	}
+}
+
+void Scheduler::cancel(int8_t task) noexcept
+{
+	if (task >= 0 && task < MAX_TASKS) {
+		tasks[task].kind = Kind::FREE;
+		tasks[task].pending = false;
+	}
+}
+
+void Scheduler::start() noexcept
+{
+#if defined(TARGET_LIKE_MBED)
+	ticker.attach_us(callback(this, &Scheduler::tick), TICK_US);
+#endif
+}
+
+void Scheduler::stop() noexcept
+{
+#if defined(TARGET_LIKE_MBED)
+	ticker.detach();
+#endif
+}
+
+bool Scheduler::ready(Task &t, uint32_t nowMs, uint32_t &releasedMs) noexcept
+{
+	switch (t.kind) {
+	case Kind::PERIODIC:
+	case Kind::ONE_SHOT:
+		releasedMs = t.dueMs;
+		return (int32_t)(nowMs - t.dueMs) >= 0;
+	case Kind::EVENT:
+		releasedMs = t.readyMs;
+		return t.pending;
+	default:
+		return false;
+	}
+}
+
+bool Scheduler::runOnce() noexcept
+{
+	const uint32_t nowMs = ticks;
+	for (Task &t: tasks) {
+		uint32_t releasedMs;
+		if (!ready(t, nowMs, releasedMs)) {
+			continue;
+		}
+		const bool oneShot = (t.kind == Kind::ONE_SHOT);
+		const uint32_t deadlineMs = t.deadlineMs;
+		if (t.kind == Kind::EVENT) {
+			t.pending = false;	// signals during the run make it ready again
+		} else if (oneShot) {
+			t.kind = Kind::FREE;	// the task may re-arm itself from fn
+		}
+
+		const uint32_t startUs = sNowUs();
+		t.fn(t.ctx);
+		const uint32_t us = sNowUs() - startUs;
+		const uint32_t finishMs = ticks;
+
+		if (oneShot && t.kind != Kind::FREE) {
+			// fn added a task into the freed slot, this run is not its own
+			return true;
+		}
+		t.stats.runs++;
+		t.stats.lastUs = us;
+		t.stats.totalUs += us;
+		if (us > t.stats.maxUs) {
+			t.stats.maxUs = us;
+		}
+		if (deadlineMs != 0 && finishMs - releasedMs > deadlineMs) {
+			t.stats.deadlineMisses++;
+		}
+		if (t.kind == Kind::PERIODIC) {
+			t.dueMs += t.periodMs;
+			if ((int32_t)(finishMs - t.dueMs) > 0) {
+				// A whole release went by: count it and realign, no burst
+				t.stats.deadlineMisses++;
+				t.dueMs = finishMs + t.periodMs;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+void Scheduler::run() noexcept
+{
+	while (true) {
+		if (!runOnce()) {
+			// Any interrupt wakes us, the tick at the latest
+#if defined(TARGET_LIKE_MBED)
+			sleep();
+#else
+			std::this_thread::sleep_for(std::chrono::microseconds(TICK_US / 4));
+#endif
+		}
+	}
+}
+
+void Scheduler::getStats(int8_t task, TaskStats *stats) const noexcept
+{
+	if (task >= 0 && task < MAX_TASKS && stats != nullptr) {
+		*stats = tasks[task].stats;
+	}
+}
+
+void Scheduler::resetStats() noexcept
+{
+	for (Task &t: tasks) {
+		t.stats = TaskStats();
+	}
+}
+
+void Scheduler::printReport() const noexcept
+{
+	for (uint8_t i = 0; i < MAX_TASKS; i++) {
+		const Task &t = tasks[i];
+		if (t.kind == Kind::FREE) {
+			continue;
+		}
+		const uint32_t avg = t.stats.runs ? t.stats.totalUs / t.stats.runs : 0;
+		printf("task %u %s runs %lu us last %lu avg %lu max %lu misses %lu\r\n",
+			   i, t.name ? t.name : "?", (unsigned long)t.stats.runs,
+			   (unsigned long)t.stats.lastUs, (unsigned long)avg,
+			   (unsigned long)t.stats.maxUs, (unsigned long)t.stats.deadlineMisses);
+	}
+}
+
+/* EOF */
@@ -0,0 +1,124 @@
+/** @file Scheduler.hpp
+ *
+ * Small cooperative run-to-completion scheduler for the bare-metal panel.
+ *
+ * A hardware timer (mbed Ticker) advances a millisecond tick. Tasks are
+ * plain functions that return quickly and come in three kinds:
+ * periodic (every N ms), one-shot (once, N ms from now) and event tasks
+ * (whenever signal() was called, also from interrupts). run() keeps
+ * picking the highest priority ready task and sleeps until the next
+ * interrupt when nothing is ready. Priority is the slot order, so tasks
+ * added first come first; a one-shot takes the lowest free slot.
+ *
+ * Every task's execution time is measured in microseconds. A deadline
+ * miss is counted when a task finishes later than its deadline after
+ * it became ready, or when a periodic task is still waiting at its next
+ * release and a period is skipped.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef Scheduler_hpp
+#define Scheduler_hpp
+
+#include <cstdint>
+
+#if defined(TARGET_LIKE_MBED)
+#include "mbed.h"
+#endif
+
+
+class Scheduler {
+public:
+	static const uint8_t MAX_TASKS = 10;
+	static const uint32_t TICK_US = 1000;
+
+	typedef void (*TaskFn)(void *ctx);
+
+	struct TaskStats {
+		uint32_t runs;
+		uint32_t lastUs;		// execution time of the last run
+		uint32_t maxUs;
+		uint32_t totalUs;		// wraps after about 70 minutes of CPU time
+		uint32_t deadlineMisses;
+	};
+
+	Scheduler() noexcept;
+	~Scheduler();
+
+	/**
+	 * Run fn every periodMs, first after one period. A deadline of 0
+	 * means the period. Returns the task handle or -1 when all slots are
+	 * used.
+	 */
+	int8_t addPeriodic(const char *name, TaskFn fn, void *ctx,
+					   uint32_t periodMs, uint32_t deadlineMs = 0) noexcept;
+
+	/** Run fn once, delayMs from now; the slot is freed after the run */
+	int8_t addOneShot(const char *name, TaskFn fn, void *ctx,
+					  uint32_t delayMs, uint32_t deadlineMs = 0) noexcept;
+
+	/** Run fn after each signal(), several signals before it runs merge */
+	int8_t addEvent(const char *name, TaskFn fn, void *ctx,
+					uint32_t deadlineMs = 0) noexcept;
+
+	/** Make an event task ready; safe from interrupts */
+	void signal(int8_t task) noexcept;
+
+	/** Remove a task, also a one-shot that has not fired yet */
+	void cancel(int8_t task) noexcept;
+
+	/** Start the tick timer */
+	void start() noexcept;
+	void stop() noexcept;
+
+	/** Advance the tick by one, called by the timer interrupt */
+	void tick() noexcept { ticks++; }
+
+	/** Milliseconds since start(), wraps around */
+	uint32_t now() const noexcept { return ticks; }
+
+	/** Run the highest priority ready task, false when none was ready */
+	bool runOnce() noexcept;
+
+	/** Run tasks forever, sleeping while none is ready */
+	void run() noexcept;
+
+	void getStats(int8_t task, TaskStats *stats) const noexcept;
+	void resetStats() noexcept;
+
+	/** Print one line per task: runs, execution times and misses */
+	void printReport() const noexcept;
+
+private:
+	enum class Kind : uint8_t {
+		FREE,
+		PERIODIC,
+		ONE_SHOT,
+		EVENT,
+	};
+
+	struct Task {
+		const char *name;
+		TaskFn fn;
+		void *ctx;
+		uint32_t periodMs;
+		uint32_t deadlineMs;
+		uint32_t dueMs;			// release time of periodic and one-shot tasks
+		uint32_t readyMs;		// when an event task was signalled
+		TaskStats stats;
+		Kind kind;
+		volatile bool pending;	// event task signalled
+	};
+
+	int8_t add(Kind kind, const char *name, TaskFn fn, void *ctx,
+			   uint32_t periodMs, uint32_t delayMs, uint32_t deadlineMs) noexcept;
+	bool ready(Task &t, uint32_t nowMs, uint32_t &releasedMs) noexcept;
+
+	Task tasks[MAX_TASKS];
+	volatile uint32_t ticks;
+#if defined(TARGET_LIKE_MBED)
+	Ticker ticker;
+#endif
+};
+
+#endif /* Scheduler_hpp */
@@ -0,0 +1,65 @@
+/** @file SpscQueue.hpp
+ *
+ * Lock-free single producer, single consumer queue with a fixed capacity.
+ *
+ * Meant for handing events from one interrupt handler to the main loop:
+ * the producer only writes the write index, the consumer only the read
+ * index, so neither side ever needs to mask interrupts. Indices run freely
+ * in 8 bits and are masked on access, the capacity must be a power of two
+ * no larger than 128.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef SpscQueue_hpp
+#define SpscQueue_hpp
+
+#include <atomic>
+#include <cstdint>
+
+
+template <typename T, uint8_t N>
+class SpscQueue {
+	static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0,
+				  "SpscQueue capacity must be a power of two, 2..128");
+public:
+	SpscQueue() noexcept : items(), widx(0), ridx(0) {}
+
+	/** Producer side: add an item, false when the queue is full */
+	bool push(const T &item) noexcept {
+		const uint8_t w = widx.load(std::memory_order_relaxed);
+		if ((uint8_t)(w - ridx.load(std::memory_order_acquire)) >= N) {
+			return false;
+		}
+		items[w & (N - 1)] = item;
+		widx.store((uint8_t)(w + 1), std::memory_order_release);
+		return true;
+	}
+
+	/** Consumer side: take the oldest item, false when the queue is empty */
+	bool pop(T &item) noexcept {
+		const uint8_t r = ridx.load(std::memory_order_relaxed);
+		if (r == widx.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = items[r & (N - 1)];
+		ridx.store((uint8_t)(r + 1), std::memory_order_release);
+		return true;
+	}
+
+	/** Items waiting, exact on the consumer side */
+	uint8_t size() const noexcept {
+		return (uint8_t)(widx.load(std::memory_order_acquire)
+						 - ridx.load(std::memory_order_acquire));
+	}
+
+	bool empty() const noexcept { return size() == 0; }
+
+	static constexpr uint8_t capacity() noexcept { return N; }
+
+private:
+	T items[N];
+	std::atomic<uint8_t> widx;	// written by the producer only
+	std::atomic<uint8_t> ridx;	// written by the consumer only
+};
+
+#endif /* SpscQueue_hpp */
@@ -0,0 +1,89 @@
+/** @file SwitchScanner.cpp
+ *
+ * Timer driven scanner for the ten panel push switches.
+ *
+ * @license: BSD 3-Clause License
+ */
+#if defined(TARGET_LIKE_MBED)
+
+#include "SwitchScanner.hpp"
+#include "us_ticker_api.h"
+
+
+// Switches per GPIO port: sw1 PC_8, sw2 PC_6, sw3 PC_5, sw4 PA_12,
+// sw5 PA_11, sw6 PB_11, sw7 PB_2, sw8 PB_1, sw9 PC_4, sw10 PF_5
+static const uint32_t kMaskA = (1U << 11) | (1U << 12);
+static const uint32_t kMaskB = (1U << 1) | (1U << 2) | (1U << 11);
+static const uint32_t kMaskC = (1U << 4) | (1U << 5) | (1U << 6) | (1U << 8);
+static const uint32_t kMaskF = (1U << 5);
+
+
+SwitchScanner::SwitchScanner(uint32_t periodUs) noexcept
+	: portA(PortA, kMaskA), portB(PortB, kMaskB), portC(PortC, kMaskC),
+	  portF(PortF, kMaskF), periodUs(periodUs), downMask(0), overflowCount(0)
+{
+	// Switches pull to ground when pressed
+	portA.mode(PullUp);
+	portB.mode(PullUp);
+	portC.mode(PullUp);
+	portF.mode(PullUp);
+}
+
+SwitchScanner::~SwitchScanner()
+{
+	stop();
+}
+
+void SwitchScanner::start() noexcept
+{
+	ticker.attach_us(callback(this, &SwitchScanner::scan), periodUs);
+}
+
+void SwitchScanner::stop() noexcept
+{
+	ticker.detach();
+}
+
+uint16_t SwitchScanner::sample()
+{
+	// Pressed reads low, invert so a set bit means pressed
+	const uint32_t a = ~(uint32_t)portA.read();
+	const uint32_t b = ~(uint32_t)portB.read();
+	const uint32_t c = ~(uint32_t)portC.read();
+	const uint32_t f = ~(uint32_t)portF.read();
+	return (uint16_t)(((c >> 8) & 1U) << SW1
+					  | ((c >> 6) & 1U) << SW2
+					  | ((c >> 5) & 1U) << SW3
+					  | ((a >> 12) & 1U) << SW4
+					  | ((a >> 11) & 1U) << SW5
+					  | ((b >> 11) & 1U) << SW6
+					  | ((b >> 2) & 1U) << SW7
+					  | ((b >> 1) & 1U) << SW8
+					  | ((c >> 4) & 1U) << SW9
+					  | ((f >> 5) & 1U) << SW10);
+}
+
+// Ticker interrupt
+void SwitchScanner::scan()
+{
+	uint16_t changed = debouncer.update(sample());
+	if (changed == 0) {
+		return;
+	}
+	const uint16_t state = debouncer.state();
+	downMask = state;
+	const uint32_t now = (uint32_t)ticker_read_us(get_us_ticker_data());
+	for (uint8_t sw = 0; changed != 0; sw++, changed >>= 1) {
+		if ((changed & 1U) == 0) {
+			continue;
+		}
+		const Event event = { now, sw, (bool)((state >> sw) & 1U) };
+		if (!events.push(event)) {
+			overflowCount++;
+		}
+	}
+}
+
+#endif // TARGET_LIKE_MBED
+
+/* EOF */
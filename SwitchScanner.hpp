@@ -0,0 +1,114 @@
+/** @file SwitchScanner.hpp
+ *
+ * Timer driven scanner for the ten panel push switches.
+ *
+ * A Ticker samples all switches at a fixed rate (1 kHz by default) with
+ * one port read per GPIO port instead of ten pin reads. SwitchDebouncer
+ * filters all switches at once with vertical counters: a switch changes
+ * state after four equal samples in a row, so a press shows up 4-5 ms
+ * after the contact settles and bounces shorter than that are ignored.
+ * Every state change goes into a lock-free queue as a press or release
+ * event with a microsecond timestamp; the main loop drains it with
+ * poll() whenever it gets around to it.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef SwitchScanner_hpp
+#define SwitchScanner_hpp
+
+#include <cstdint>
+
+#include "SpscQueue.hpp"
+
+#if defined(TARGET_LIKE_MBED)
+#include "mbed.h"
+#endif
+
+#ifdef MBED_CONF_APP_SWITCH_SCAN_PERIOD_US
+#define SWITCH_SCAN_PERIOD_US MBED_CONF_APP_SWITCH_SCAN_PERIOD_US
+#else
+#define SWITCH_SCAN_PERIOD_US 1000
+#endif
+
+
+/*
+ * Vertical counter debouncer, bit n of every word belongs to switch n.
+ * cnt1:cnt0 is a two bit counter per switch of samples that differ from
+ * the debounced state; it restarts whenever a sample agrees again.
+ */
+class SwitchDebouncer {
+public:
+	SwitchDebouncer() noexcept : cnt0(0), cnt1(0), debounced(0) {}
+
+	/** Feed one sample (1 = pressed), returns the bits that changed */
+	uint16_t update(uint16_t sample) noexcept {
+		const uint16_t delta = sample ^ debounced;
+		cnt1 = (cnt1 ^ cnt0) & delta;
+		cnt0 = ~cnt0 & delta;
+		const uint16_t toggle = delta & ~(cnt0 | cnt1);
+		debounced ^= toggle;
+		return toggle;
+	}
+
+	uint16_t state() const noexcept { return debounced; }
+
+private:
+	uint16_t cnt0;
+	uint16_t cnt1;
+	uint16_t debounced;
+};
+
+
+#if defined(TARGET_LIKE_MBED)
+
+class SwitchScanner {
+public:
+	enum Switch : uint8_t {
+		SW1 = 0, SW2, SW3, SW4, SW5,
+		SW6, SW7, SW8, SW9, SW10,
+		COUNT
+	};
+
+	struct Event {
+		uint32_t us;	// 32 bit us time of the sample that settled it
+		uint8_t sw;		// Switch
+		bool pressed;	// false: released
+	};
+
+	explicit SwitchScanner(uint32_t periodUs = SWITCH_SCAN_PERIOD_US) noexcept;
+	~SwitchScanner();
+
+	void start() noexcept;
+	void stop() noexcept;
+
+	/** Take the oldest press or release event, false when there is none */
+	bool poll(Event &event) noexcept { return events.pop(event); }
+
+	/** Debounced state, bit n set while switch n is held down */
+	uint16_t down() const noexcept { return downMask; }
+	bool isDown(Switch sw) const noexcept { return (downMask >> sw) & 1U; }
+
+	/** Events lost because the main loop did not drain the queue */
+	uint32_t overflows() const noexcept { return overflowCount; }
+
+private:
+	static const uint8_t QUEUE_SIZE = 16;
+
+	void scan();
+	uint16_t sample();
+
+	PortIn portA;
+	PortIn portB;
+	PortIn portC;
+	PortIn portF;
+	Ticker ticker;
+	uint32_t periodUs;
+	SwitchDebouncer debouncer;
+	SpscQueue<Event, QUEUE_SIZE> events;
+	volatile uint16_t downMask;
+	volatile uint32_t overflowCount;
+};
+
+#endif // TARGET_LIKE_MBED
+
+#endif /* SwitchScanner_hpp */
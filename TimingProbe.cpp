@@ -0,0 +1,141 @@
+/** @file TimingProbe.cpp
+ *
+ * Named timing probes with fixed-bucket histograms.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include "TimingProbe.hpp"
+
+#include <cstdio>
+
+#if defined(TARGET_LIKE_MBED)
+#include "us_ticker_api.h"
+#else
+#include <chrono>
+#endif
+
+
+TimingProbe *TimingProbe::list = nullptr;
+
+
+uint32_t TimingProbe::nowUs() noexcept
+{
+#if defined(TARGET_LIKE_MBED)
+	// Extended ticker, the raw counter wraps every 65 ms on the F0
+	return (uint32_t)ticker_read_us(get_us_ticker_data());
+#else
+	return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+TimingProbe::TimingProbe(const char *name, uint32_t lowUs, uint32_t bucketUs) noexcept
+	: name(name), lowUs(lowUs), bucketUs(bucketUs ? bucketUs : 1), startUs(0),
+	  count(0), minUs(UINT32_MAX), maxUs(0), totalUs(0), below(0), above(0),
+	  buckets(), armed(false), next(list)
+{
+	list = this;
+}
+
+TimingProbe::~TimingProbe()
+{
+	for (TimingProbe **p = &list; *p != nullptr; p = &(*p)->next) {
+		if (*p == this) {
+			*p = next;
+			break;
+		}
+	}
+}
+
+void TimingProbe::mark() noexcept
+{
+	const uint32_t now = nowUs();
+	if (armed) {
+		record(now - startUs);
+	}
+	startUs = now;
+	armed = true;
+}
+
+void TimingProbe::record(uint32_t us) noexcept
+{
+	count++;
+	totalUs += us;
+	if (us < minUs) {
+		minUs = us;
+	}
+	if (us > maxUs) {
+		maxUs = us;
+	}
+	if (us < lowUs) {
+		below++;
+		return;
+	}
+	const uint32_t index = (us - lowUs) / bucketUs;
+	if (index >= BUCKETS) {
+		above++;
+	} else if (buckets[index] != UINT16_MAX) {
+		buckets[index]++;
+	}
+}
+
+void TimingProbe::reset() noexcept
+{
+	count = 0;
+	minUs = UINT32_MAX;
+	maxUs = 0;
+	totalUs = 0;
+	below = 0;
+	above = 0;
+	for (uint16_t &b: buckets) {
+		b = 0;
+	}
+	armed = false;	// the next period starts from the next mark()
+}
+
+void TimingProbe::getStats(Stats *stats) const noexcept
+{
+	if (stats == nullptr) {
+		return;
+	}
+	stats->count = count;
+	stats->minUs = count ? minUs : 0;
+	stats->meanUs = count ? totalUs / count : 0;
+	stats->maxUs = maxUs;
+	stats->below = below;
+	stats->above = above;
+}
+
+void TimingProbe::print() const noexcept
+{
+	Stats s;
+	getStats(&s);
+	printf("probe %s n %lu us min %lu mean %lu max %lu jitter %lu below %lu above %lu\r\n",
+		   name ? name : "?", (unsigned long)s.count, (unsigned long)s.minUs,
+		   (unsigned long)s.meanUs, (unsigned long)s.maxUs,
+		   (unsigned long)(s.maxUs - s.minUs), (unsigned long)s.below,
+		   (unsigned long)s.above);
+	for (uint8_t i = 0; i < BUCKETS; i++) {
+		if (buckets[i] != 0) {
+			const uint32_t lo = lowUs + i * bucketUs;
+			printf("  %lu-%lu: %u\r\n", (unsigned long)lo,
+				   (unsigned long)(lo + bucketUs - 1), buckets[i]);
+		}
+	}
+}
+
+void TimingProbe::printAll() noexcept
+{
+	for (const TimingProbe *p = list; p != nullptr; p = p->next) {
+		p->print();
+	}
+}
+
+void TimingProbe::resetAll() noexcept
+{
+	for (TimingProbe *p = list; p != nullptr; p = p->next) {
+		p->reset();
+	}
+}
+
+/* EOF */
@@ -0,0 +1,84 @@
+/** @file TimingProbe.hpp
+ *
+ * Named timing probes with fixed-bucket histograms.
+ *
+ * A probe measures either the interval between successive mark() calls
+ * (a period: note to note, input scan to input scan) or the time from
+ * start() to stop() (a duration: one idle() call). Times come from the
+ * free running microsecond ticker, extended to 32 bits, so a probe
+ * costs two timer reads and a few adds.
+ *
+ * Every probe has BUCKETS linear buckets of bucketUs starting at lowUs,
+ * plus counts below and above that window, and keeps count, min, mean
+ * and max. Pick the window around the expected value: a period probe for
+ * a 100 ms step with 250 us buckets from 98 ms shows the jitter directly.
+ * Bucket counts saturate instead of wrapping.
+ *
+ * Probes link themselves into a list on construction, printAll() dumps
+ * every probe. Record from the main loop only, not from interrupts.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef TimingProbe_hpp
+#define TimingProbe_hpp
+
+#include <cstdint>
+
+
+class TimingProbe {
+public:
+	static const uint8_t BUCKETS = 16;
+
+	struct Stats {
+		uint32_t count;
+		uint32_t minUs;
+		uint32_t meanUs;
+		uint32_t maxUs;
+		uint32_t below;		// samples under lowUs
+		uint32_t above;		// samples past the last bucket
+	};
+
+	TimingProbe(const char *name, uint32_t lowUs, uint32_t bucketUs) noexcept;
+	~TimingProbe();
+
+	/** Record the time since the previous mark(), the first one only arms */
+	void mark() noexcept;
+
+	/** Start and end a duration */
+	void start() noexcept { startUs = nowUs(); }
+	void stop() noexcept { record(nowUs() - startUs); }
+
+	/** Add one sample */
+	void record(uint32_t us) noexcept;
+
+	void reset() noexcept;
+	void getStats(Stats *stats) const noexcept;
+	uint16_t bucket(uint8_t index) const noexcept { return buckets[index]; }
+
+	/** Print the summary and the non-empty buckets */
+	void print() const noexcept;
+
+	static void printAll() noexcept;
+	static void resetAll() noexcept;
+
+	static uint32_t nowUs() noexcept;
+
+private:
+	const char *name;
+	uint32_t lowUs;
+	uint32_t bucketUs;
+	uint32_t startUs;		// start() time or the last mark()
+	uint32_t count;
+	uint32_t minUs;
+	uint32_t maxUs;
+	uint32_t totalUs;		// for the mean, wraps after about 70 minutes
+	uint32_t below;
+	uint32_t above;
+	uint16_t buckets[BUCKETS];
+	bool armed;				// mark() has a previous time
+	TimingProbe *next;
+
+	static TimingProbe *list;
+};
+
+#endif /* TimingProbe_hpp */
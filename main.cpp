@@ -18,6 +18,7 @@
 #include "mbed_wait_api.h"
 #include "nts-1.h"
 #include "stm32f030x8.h"
+#include "us_ticker_api.h"
 #include <cstdint>
 
 
@@ -26,58 +27,292 @@
  */
  #include "Harmony.hpp"
  #include "Scale.hpp"
+ #include "ModulationScheduler.hpp"
+ #include "NTS1Script.hpp"
+ #include "SwitchScanner.hpp"
+ #include "AdcScanner.hpp"
+ #include "AnalogConditioner.hpp"
+ #include "Scheduler.hpp"
+ #include "ControlMap.hpp"
+ #include "RibbonGesture.hpp"
+ #include "BinLog.hpp"
+ #include "TimingProbe.hpp"
+ #include "LedDriver.hpp"
 
 #define WAIT_TIME_MS 500 
 #define PWM  0 
 
+#define STEP_MS      100	// sequencer step
+#define GATE_MS      90		// note length within a step
+#define NUM_STEPS    9
+
+#ifdef MBED_CONF_APP_RIBBON_ZONES
+#define RIBBON_ZONES MBED_CONF_APP_RIBBON_ZONES
+#else
+#define RIBBON_ZONES 8
+#endif
+#define RIBBON_VELOCITY 100
+#define NO_NOTE      0xFF
+
+// Timing histograms, windows around the expected values; hold sw2 and
+// press sw3 to print and clear them
+static TimingProbe notePeriod("note period", STEP_MS * 1000 - 2000, 250);
+static TimingProbe inputPeriod("input period", 4000, 125);
+static TimingProbe idleTime("idle", 0, 25);
+
+// Ribbon keyboard: C major from middle C, one note per zone
+static const uint8_t kRibbonNotes[RibbonGesture::MAX_ZONES] = {
+	60, 62, 64, 65, 67, 69, 71, 72, 74, 76, 77, 79, 81, 83, 84, 86,
+};
+
+
+/*
+ * Initial sound, sent as the TX ring has room instead of blocking main,
+ * then read back the filter type to see the main board took it.
+ */
+class InitScript : public NTS1Script {
+public:
+	InitScript(NTS1 &nts1, BinLog &log) noexcept : NTS1Script(nts1), log(log) {}
+
+	Status run() noexcept override {
+		PT_BEGIN();
+		PT_WAIT_UNTIL(nts1.set<NTS1::OscType, 3>() == NTS1::STATUS_OK);
+		PT_WAIT_UNTIL(nts1.set<NTS1::RevType, 2>() == NTS1::STATUS_OK);
+		PT_WAIT_UNTIL(nts1.set<NTS1::RevDepth, 1023>() == NTS1::STATUS_OK);
+		PT_WAIT_UNTIL(nts1.set<NTS1::RevTime, 600>() == NTS1::STATUS_OK);
+		PT_WAIT_UNTIL(nts1.set<NTS1::RevMix, 1023>() == NTS1::STATUS_OK);
+		PT_WAIT_UNTIL(nts1.set<NTS1::FiltType, 1>() == NTS1::STATUS_OK);
+
+		PT_WAIT_UNTIL(request<NTS1::FiltType>());
+		PT_WAIT_UNTIL(replied());
+		if (replyValid()) {
+			log.log(BinLog::INIT_DONE, replyValue());
+		} else {
+			log.log(BinLog::INIT_NO_REPLY);
+		}
+		PT_END();
+	}
+
+private:
+	BinLog &log;
+};
+
+
+
+/*
+ * What the controls do: source, switches to hold, parameter, rate, curve
+ */
+#define SW(n) (1U << SwitchScanner::SW##n)
+static const ControlMap::Mapping kControlMappings[] = {
+	ControlMap::map<NTS1::FiltPeak>("FILT_PEAK", AdcScanner::RIBBON, SW(1), 100),
+	ControlMap::map<NTS1::OscShape>("OSC_SHAPE", AdcScanner::POT, SW(7), 100),
+	ControlMap::map<NTS1::FiltLfoDepth>("FILT_LFO_DEPTH", AdcScanner::RIBBON, SW(9), 50,
+		ModulationScheduler::Priority::LOW),
+	ControlMap::map<NTS1::FiltCutoff>("FILT_CUTOFF", AdcScanner::POT, SW(10), 200,
+		ModulationScheduler::Priority::HIGH, ControlMap::Curve::EXP),
+	ControlMap::map<NTS1::RevTime>("REV_TIME", AdcScanner::POT, SW(8), 50,
+		ModulationScheduler::Priority::LOW, ControlMap::Curve::EXP),
+};
+#undef SW
+
+/*
+ * State shared by the tasks below, they all run from Scheduler::run()
+ */
+struct Panel {
+	NTS1 &nts1;
+	ScriptRunner &scripts;
+	ModulationScheduler &modulation;
+	ControlMap &controlMap;
+	RibbonGesture &ribbon;
+	SwitchScanner &switches;
+	AnalogConditioner *controls;	// indexed by AdcScanner::Channel
+	LedDriver &leds;
+	Scheduler &scheduler;
+	BinLog &log;
+	int8_t controlsTask;
+	int8_t ribbonTask;
+	uint16_t held;		// switches down
+	uint16_t pressed;	// presses not yet seen by the controls task
+	uint16_t released;	// releases not yet seen by the controls task
+	uint8_t step;
+	uint8_t stepLeds;
+	uint8_t playing;	// note of the current step
+	uint8_t ribbonNote;	// note held on the ribbon keyboard or NO_NOTE
+};
+
+// ADC DMA interrupt: feed every channel's new block average (12 bit) to
+// its conditioner as a 10 bit control value, wake the controls task when
+// one of them moved. The ribbon also goes to the gesture engine.
+static void onAdcBlock(void *ctx, const uint16_t *values, uint8_t count)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	if (panel->ribbon.update(values[AdcScanner::RIBBON])) {
+		panel->scheduler.signal(panel->ribbonTask);
+	}
+	bool moved = false;
+	for (uint8_t ch = 0; ch < count; ch++) {
+		moved |= panel->controls[ch].update(values[ch] >> 2);
+	}
+	if (moved) {
+		panel->scheduler.signal(panel->controlsTask);
+	}
+}
+
+// 1 ms: link RX processing, scripts and modulation budget
+static void linkTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	idleTime.start();
+	panel->nts1.idle();
+	idleTime.stop();
+	panel->scripts.service();
+	// The extended ticker, us_ticker_read() wraps every 65 ms on the F0
+	panel->modulation.service((uint32_t)ticker_read_us(get_us_ticker_data()));
+}
+
+// Event: ribbon gestures. With no switch held the ribbon is a keyboard,
+// each zone plays a note; with switches held it is left to the control
+// map. A note that was started always gets its note off.
+static void ribbonTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	RibbonGesture::Event event;
+	while (panel->ribbon.poll(event)) {
+		if (event.type == RibbonGesture::Type::ZONE_OFF && panel->ribbonNote != NO_NOTE) {
+			panel->nts1.noteOff(panel->ribbonNote);
+			panel->ribbonNote = NO_NOTE;
+		} else if (event.type == RibbonGesture::Type::ZONE_ON && panel->held == 0) {
+			panel->ribbonNote = kRibbonNotes[event.zone];
+			panel->nts1.noteOn(panel->ribbonNote, RIBBON_VELOCITY);
+			panel->log.log(BinLog::RIBBON_NOTE, event.zone, panel->ribbonNote);
+		}
+	}
+}
+
+// 5 ms: collect debounced switch events
+static void inputTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	inputPeriod.mark();
+	SwitchScanner::Event event;
+	uint16_t pressed = 0;
+	uint16_t released = 0;
+	while (panel->switches.poll(event)) {
+		if (event.pressed)
+			pressed |= 1U << event.sw;
+		else
+			released |= 1U << event.sw;
+	}
+	panel->held = panel->switches.down();
+	if (pressed | released) {
+		panel->pressed |= pressed;
+		panel->released |= released;
+		panel->scheduler.signal(panel->controlsTask);
+	}
+}
+
+// Event: a control moved or a switch changed, the control map decides
+// what goes to the NTS-1. A press shorter than the scan interval still
+// counts as held once.
+static void controlsTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	const uint16_t pressed = panel->pressed;
+	const uint16_t released = panel->released;
+	const uint16_t held = panel->held | pressed;
+	panel->pressed = 0;
+	panel->released = 0;
+
+	if ((pressed & (1U << SwitchScanner::SW3)) && (held & (1U << SwitchScanner::SW2))) {
+		panel->log.flush();		// no text inside a half sent record
+		TimingProbe::printAll();
+		TimingProbe::resetAll();
+	}
+	if (pressed | released)
+		panel->controlMap.switchesChanged(held, pressed, released);
+	for (uint8_t ch = 0; ch < AdcScanner::COUNT; ch++) {
+		if (panel->controls[ch].takeChange())
+			panel->controlMap.controlChanged(ch, held);
+	}
+}
+
+// One-shot: end of the current step's note
+static void noteOffTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	panel->nts1.noteOff(panel->playing);
+}
+
+// STEP_MS: play the next note of the run, the LEDs trail by one step
+static void sequencerTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	panel->playing = 60 + panel->step;
+	panel->nts1.noteOn(panel->playing, 100);
+	notePeriod.mark();
+	panel->leds = panel->stepLeds;
+	panel->scheduler.addOneShot("noteoff", &noteOffTask, panel, GATE_MS);
+	panel->stepLeds = 1 << panel->step;
+	panel->step = (panel->step + 1) % NUM_STEPS;
+}
+
+// 1 ms, lowest priority: move queued log records to the console
+static void logTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	panel->log.drain();
+}
+
+// 1 s: hold sw2 to report link buffer usage for this session
+static void reportTask(void *ctx)
+{
+	Panel *panel = static_cast<Panel *>(ctx);
+	if(!(panel->held & (1U << SwitchScanner::SW2)))
+		return;
+	panel->log.flush();
+	NTS1 &nts1 = panel->nts1;
+	nts1_buf_stats_t bufStats;
+	nts1.getBufStats(&bufStats);
+	printf("TX buf %u/%u rejects %lu, RX buf %u/%u overflows %lu\r\n",
+		bufStats.tx_high_water, bufStats.tx_size,
+		(unsigned long)bufStats.tx_rejects,
+		bufStats.rx_high_water, bufStats.rx_size,
+		(unsigned long)bufStats.rx_overflows);
+	nts1_link_stats_t linkStats;
+	nts1.getLinkStats(&linkStats);
+	printf("link state %u lost %lu panel id changes %lu restores %lu recover %lu/%lu us\r\n",
+		linkStats.state, (unsigned long)linkStats.lost_count,
+		(unsigned long)linkStats.panel_id_changes,
+		(unsigned long)linkStats.restores,
+		(unsigned long)linkStats.last_recover_us,
+		(unsigned long)linkStats.max_recover_us);
+#if NTS1_TRACE_LATENCY
+	nts1.printLatency();
+#endif
+#if NTS1_ISR_STATS
+	nts1_isr_stats_t isrStats;
+	nts1.getIsrStats(&isrStats);
+	printf("link ISR cycles %lu/%lu/%lu (budget %lu/byte) bytes/entry max %lu over budget %lu\r\n",
+		(unsigned long)isrStats.min_cycles, (unsigned long)isrStats.avg_cycles,
+		(unsigned long)isrStats.max_cycles, (unsigned long)isrStats.budget_cycles,
+		(unsigned long)isrStats.max_bytes, (unsigned long)isrStats.over_budget);
+#endif
+	panel->modulation.printReport();
+	panel->scheduler.printReport();
+}
+
 
 
 int main()
 {
-	NTS1 nts1; 
-	// Outputs 
-	DigitalOut led1(PC_10);
-	DigitalOut led2(PC_12);
-	DigitalOut led3(PF_6);
-	DigitalOut led4(PF_7);
-	DigitalOut led5(PA_15);
-	DigitalOut led6(PB_7);
-	DigitalOut led7(PC_13);
-	DigitalOut led8(PC_14);
-
-	BusOut panelled(
-		PC_10, PC_12, PF_6, PF_7,
-		PA_15, PB_7, PC_13, PC_14); 
-
-	// Push switches also enable internal pull-up  
-	DigitalIn sw1(PC_8);
-	DigitalIn sw2(PC_6);
-	DigitalIn sw3(PC_5);
-	DigitalIn sw4(PA_12);
-	DigitalIn sw5(PA_11);
-	DigitalIn sw6(PB_11);
-	DigitalIn sw7(PB_2);
-	DigitalIn sw8(PB_1);
-	DigitalIn sw9(PC_4);
-	DigitalIn sw10(PF_5);
-	sw1.mode(PinMode::PullUp);
-	sw2.mode(PinMode::PullUp);
-	sw3.mode(PinMode::PullUp);
-	sw4.mode(PinMode::PullUp);
-	sw5.mode(PinMode::PullUp);
-	sw6.mode(PinMode::PullUp);
-	sw7.mode(PinMode::PullUp);
-	sw8.mode(PinMode::PullUp);
-	sw9.mode(PinMode::PullUp);
-	sw10.mode(PinMode::PullUp);
-	
-	
-	BusIn switches(
-		PC_8, PC_6, PC_5, PA_12,
-		PA_11, PB_11, PB_2, PB_1,
-		PC_4, PF_5 
-	);
-	switches.mode(PinMode::PullUp);
+	// Static so the link buffers stay off the main stack
+	static NTS1 nts1;
+	// Outputs: the LEDs are refreshed from a timer interrupt, writing
+	// them is a framebuffer update
+	static LedDriver panelled;
+
+	// Push switches, sampled and debounced from a timer interrupt
+	static SwitchScanner switches;
 
 
 #if PWM
@@ -87,11 +322,12 @@ int main()
 #endif 
 
 
-	AnalogIn ain(PC_2);
-	AnalogIn ribbon(PA_0);
-	
-	uint8_t i, j;
-	uint16_t val, val2; 
+	// Ribbon and pot are sampled continuously by ADC + DMA and conditioned
+	// in the DMA interrupt, so noise does not become parameter changes
+	static AnalogConditioner controls[AdcScanner::COUNT];
+	static AdcScanner adc;
+	static RibbonGesture ribbon;
+	ribbon.setZones(RIBBON_ZONES);
 
     printf("Korg NTS-1 Custom Panel used with MBED OS code by: J-W Smaal, \
 	running on Mbed OS %d.%d.%d.\n", \
@@ -100,18 +336,28 @@ int main()
 
 
 
-	// Setting up some initial parameters to play with  
-	//nts1.paramChange(NTS1::PARAM_ID_OSC_BASE, 0, 1);
-	nts1.paramChange(NTS1::PARAM_ID_OSC_TYPE, 0, 3); 
-	
-	//nts1.paramChange(NTS1::PARAM_ID_REV_BASE, 0, 1);
-	nts1.paramChange(NTS1::PARAM_ID_REV_TYPE, 0, 2);
-	nts1.paramChange(NTS1::PARAM_ID_REV_DEPTH, 0, 1024); 
-	nts1.paramChange(NTS1::PARAM_ID_REV_TIME, 0, 600); 
-	nts1.paramChange(NTS1::PARAM_ID_REV_MIX, 0, 1024); 
+	// Messages from the tasks go through the binary log, drained by the
+	// lowest priority task instead of blocking on the UART
+	static BinLog binlog;
 
-	//nts1.paramChange(NTS1::PARAM_ID_FILT_BASE, 0, 1);
-	nts1.paramChange(NTS1::PARAM_ID_FILT_TYPE, 0, 1);
+	// Setting up some initial parameters to play with, the script runs
+	// alongside everything else
+	static ScriptRunner scripts(nts1);
+	static InitScript initScript(nts1, binlog);
+	scripts.start(initScript);
+
+	// Knob and ribbon values go out through the modulation scheduler so
+	// they never crowd out note events on the link
+	static ModulationScheduler modulation(nts1);
+	static ControlMap controlMap(modulation, controls, AdcScanner::COUNT);
+	controlMap.begin(kControlMappings,
+		sizeof(kControlMappings) / sizeof(kControlMappings[0]));
+	controlMap.setEcho(&binlog);
+	static Scheduler scheduler;
+	static Panel panel = {
+		nts1, scripts, modulation, controlMap, ribbon, switches, controls,
+		panelled, scheduler, binlog, -1, -1, 0, 0, 0, 0, 0, 0, NO_NOTE,
+	};
 
 
 #if 0
@@ -132,59 +378,24 @@ int main()
 	printf("\r\n");
 #endif
 
-    while (true)
-    {		
-		for(i = 0; i < 9; j = 1<<i, i++) {
-			nts1.noteOn(60 + i, 100);
-			panelled = j; 
-			wait_ms(100);
-			nts1.idle();
-			
-			val = ribbon.read_u16()>>6;  
-			val2 = ain.read_u16()>>6;   // Make it 10 bit 
-			
-			if(sw1.read() == false) { 
-				printf("FILT_PEAK: %u\r\n", val);
-				nts1.paramChange(	NTS1::PARAM_ID_FILT_PEAK,
-								0, 
-								val );
-			}
-			if(sw7.read() == false ) {
-				printf("FILT_: %u\r\n", val2);
-				nts1.paramChange(	NTS1::PARAM_ID_OSC_SHAPE,
-								0, 
-								val2 );
-				wait_ms(100);
-			} 		
-
-			if(sw9.read() == false ) {
-				printf("FILT_: %u\r\n", val);
-				nts1.paramChange(	NTS1::PARAM_ID_FILT_LFO_DEPTH,
-								0, 
-								val );
-				wait_ms(100);
-			} 
-			if(sw10.read() == false)  {
-				printf("FILT_CUTOFF %u\r\n", val2);
-				nts1.paramChange(	NTS1::PARAM_ID_FILT_CUTOFF,
-								0, 
-								val2 );
-				wait_ms(100);
-			} 
-
-			if(sw8.read() == false ) 
-				printf("REV_TIME: %u\r\n", val2);
-				nts1.paramChange(	NTS1::PARAM_ID_REV_TIME, 
-							0, 
-							val2);
-			wait_ms(2);
-			nts1.idle();
-			nts1.noteOff(60 + i);
-		}
+	// Highest priority first
+	scheduler.addPeriodic("link", &linkTask, &panel, 1);
+	panel.ribbonTask = scheduler.addEvent("ribbon", &ribbonTask, &panel, 2);
+	scheduler.addPeriodic("input", &inputTask, &panel, 5);
+	panel.controlsTask = scheduler.addEvent("controls", &controlsTask, &panel, 10);
+	scheduler.addPeriodic("sequencer", &sequencerTask, &panel, STEP_MS, 5);
+	scheduler.addPeriodic("report", &reportTask, &panel, 1000);
+	scheduler.addPeriodic("log", &logTask, &panel, 1, 10);
+
+	adc.attach(&onAdcBlock, &panel);
+	adc.start();
+	switches.start();
+	panelled.start();
+	scheduler.start();
+	scheduler.run();
 
-	}  // End of while(true) 
 	nts1.teardown(); 
 	return -1;  
 }	// End of main()
 
-/* EOF */ 
\ No newline at end of file
+/* EOF */
@@ -26,105 +26,312 @@
  *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
  *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
  *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
- *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  //*/
 
 #include "nts-1.h"
+#include "nts1_port.h"
 
-static NTS1 *sNts1Instance = nullptr;
+static const uint32_t kRequestTimeoutUs = (uint32_t)NTS1_REQUEST_TIMEOUT_MS * 1000U;
 
-static nts1_note_off_event_handler sNoteOffEventHandler = nullptr;
-static nts1_note_on_event_handler sNoteOnEventHandler = nullptr; 
-static nts1_step_tick_event_handler sStepTickEventHandler = nullptr;
-static nts1_unit_desc_event_handler sUnitDescEventHandler = nullptr;
-static nts1_edit_param_desc_event_handler sEditParamDescEventHandler = nullptr;
-static nts1_value_event_handler sValueEventHandler = nullptr;
-static nts1_param_change_handler sParamChangeHandler = nullptr;
+// Link callbacks, ctx is the owning NTS1
 
+struct NTS1::Dispatch {
+  static void noteOff(void *ctx, const nts1_rx_note_off_t *note_off) {
+    static_cast<NTS1 *>(ctx)->mNoteOffListeners.dispatch(note_off);
+  }
+
+  static void noteOn(void *ctx, const nts1_rx_note_on_t *note_on) {
+    static_cast<NTS1 *>(ctx)->mNoteOnListeners.dispatch(note_on);
+  }
+
+  static void stepTick(void *ctx) {
+    static_cast<NTS1 *>(ctx)->mStepTickListeners.dispatch();
+  }
+
+  static void unitDesc(void *ctx, const nts1_rx_unit_desc_t *unit_desc) {
+    static_cast<NTS1 *>(ctx)->mUnitDescListeners.dispatch(unit_desc);
+  }
+
+  static void editParamDesc(void *ctx, const nts1_rx_edit_param_desc_t *param_desc) {
+    static_cast<NTS1 *>(ctx)->mEditParamDescListeners.dispatch(param_desc);
+  }
+
+  static void value(void *ctx, const nts1_rx_value_t *value) {
+    NTS1 *nts1 = static_cast<NTS1 *>(ctx);
+    nts1->completeRequest(value);
+    nts1->mValueListeners.dispatch(value);
+  }
+
+  static void paramChange(void *ctx, const nts1_rx_param_change_t *param_change) {
+    static_cast<NTS1 *>(ctx)->mParamChangeListeners.dispatch(param_change);
+  }
+
+  static void linkEvent(void *ctx, nts1_link_event_t event) {
+    static_cast<NTS1 *>(ctx)->mLinkListeners.dispatch(event);
+  }
+
+  // Batches go to batch listeners when there are any, otherwise each event
+  // is handed to the single event listeners so nothing is lost when a batch
+  // mask is set before the consumer subscribes.
+
+  template <typename BatchTable, typename Table, typename T>
+  static inline void batch(const BatchTable &batchTable, const Table &table,
+                           const T *events, uint8_t count) {
+    if (batchTable.count() > 0) {
+      batchTable.dispatch(events, count);
+      return;
+    }
+    for (uint8_t i = 0; i < count; ++i)
+      table.dispatch(&events[i]);
+  }
+
+  static void noteOffBatch(void *ctx, const nts1_rx_note_off_t *note_offs, uint8_t count) {
+    NTS1 *nts1 = static_cast<NTS1 *>(ctx);
+    batch(nts1->mNoteOffBatchListeners, nts1->mNoteOffListeners, note_offs, count);
+  }
+
+  static void noteOnBatch(void *ctx, const nts1_rx_note_on_t *note_ons, uint8_t count) {
+    NTS1 *nts1 = static_cast<NTS1 *>(ctx);
+    batch(nts1->mNoteOnBatchListeners, nts1->mNoteOnListeners, note_ons, count);
+  }
+
+  static void valueBatch(void *ctx, const nts1_rx_value_t *values, uint8_t count) {
+    NTS1 *nts1 = static_cast<NTS1 *>(ctx);
+    for (uint8_t i = 0; i < count; ++i)
+      nts1->completeRequest(&values[i]);
+    batch(nts1->mValueBatchListeners, nts1->mValueListeners, values, count);
+  }
+
+  static void paramChangeBatch(void *ctx, const nts1_rx_param_change_t *param_changes, uint8_t count) {
+    NTS1 *nts1 = static_cast<NTS1 *>(ctx);
+    batch(nts1->mParamChangeBatchListeners, nts1->mParamChangeListeners, param_changes, count);
+  }
+
+  static const nts1_link_handlers_t handlers;
+};
+
+const nts1_link_handlers_t NTS1::Dispatch::handlers = {
+  &NTS1::Dispatch::noteOff,
+  &NTS1::Dispatch::noteOn,
+  &NTS1::Dispatch::stepTick,
+  &NTS1::Dispatch::unitDesc,
+  &NTS1::Dispatch::editParamDesc,
+  &NTS1::Dispatch::value,
+  &NTS1::Dispatch::paramChange,
+  &NTS1::Dispatch::linkEvent,
+  &NTS1::Dispatch::noteOffBatch,
+  &NTS1::Dispatch::noteOnBatch,
+  &NTS1::Dispatch::valueBatch,
+  &NTS1::Dispatch::paramChangeBatch,
+};
+
+// ----------------------------------------------------------
+
+void NTS1::finishRequest(PendingRequest &req, const nts1_rx_value_t *value) {
+  // Free the slot first so waiters may issue new requests. A new request
+  // can land in this very slot, so call the waiters from a copy.
+  Waiter waiters[NTS1_MAX_SUBSCRIBERS];
+  const uint8_t count = req.waiterCount;
+  for (uint8_t i = 0; i < count; ++i)
+    waiters[i] = req.waiters[i];
+  req.used = false;
+  for (uint8_t i = 0; i < count; ++i)
+    waiters[i].fn(waiters[i].ctx, value);
+}
+
+void NTS1::completeRequest(const nts1_rx_value_t *value) {
+  for (PendingRequest &req : mPendingRequests) {
+    if (req.used && req.id == value->main_id && req.subid == value->sub_id) {
+      mRequestStats.completed++;
+      finishRequest(req, value);
+      return;
+    }
+  }
+}
+
+void NTS1::expireRequests(uint32_t now) {
+  for (PendingRequest &req : mPendingRequests) {
+    if (req.used && (now - req.issuedUs) > kRequestTimeoutUs) {
+      mRequestStats.timeouts++;
+      finishRequest(req, nullptr);
+    }
+  }
+}
+
+uint8_t NTS1::requestValue(uint8_t id, uint8_t subid, ValueListener fn, void *ctx) {
+  const uint32_t now = nts1_port_timestamp(port());
+  expireRequests(now);
+
+  PendingRequest *free = nullptr;
+  for (PendingRequest &req : mPendingRequests) {
+    if (!req.used) {
+      if (free == nullptr)
+        free = &req;
+      continue;
+    }
+    if (req.id != id || req.subid != subid)
+      continue;
+    // Same request already on its way, ride along
+    if (fn != nullptr) {
+      if (req.waiterCount >= NTS1_MAX_SUBSCRIBERS)
+        return STATUS_BUSY;
+      req.waiters[req.waiterCount].fn = fn;
+      req.waiters[req.waiterCount].ctx = ctx;
+      req.waiterCount++;
+    }
+    mRequestStats.saved++;
+    return STATUS_OK;
+  }
+
+  if (free == nullptr && fn != nullptr)
+    return STATUS_BUSY;
+  const uint8_t res = nts1_link_req_param_value(&mLink, id, subid);
+  if (res != STATUS_OK)
+    return res;
+  mRequestStats.sent++;
+  if (free != nullptr) {
+    free->used = true;
+    free->id = id;
+    free->subid = subid;
+    free->issuedUs = now;
+    free->waiterCount = 0;
+    if (fn != nullptr) {
+      free->waiters[0].fn = fn;
+      free->waiters[0].ctx = ctx;
+      free->waiterCount = 1;
+    }
+  }
+  return STATUS_OK;
+}
+
+// Legacy single handlers are subscribed through these adapters, the context
+// points at the handler member.
+
+static void sNoteOffAdapter(void *ctx, const nts1_rx_note_off_t *note_off) {
+  (*(nts1_note_off_event_handler *)ctx)(note_off);
+}
+
+static void sNoteOnAdapter(void *ctx, const nts1_rx_note_on_t *note_on) {
+  (*(nts1_note_on_event_handler *)ctx)(note_on);
+}
+
+static void sStepTickAdapter(void *ctx) {
+  (*(nts1_step_tick_event_handler *)ctx)();
+}
+
+static void sUnitDescAdapter(void *ctx, const nts1_rx_unit_desc_t *unit_desc) {
+  (*(nts1_unit_desc_event_handler *)ctx)(unit_desc);
+}
+
+static void sEditParamDescAdapter(void *ctx, const nts1_rx_edit_param_desc_t *param_desc) {
+  (*(nts1_edit_param_desc_event_handler *)ctx)(param_desc);
+}
+
+static void sValueAdapter(void *ctx, const nts1_rx_value_t *value) {
+  (*(nts1_value_event_handler *)ctx)(value);
+}
+
+static void sParamChangeAdapter(void *ctx, const nts1_rx_param_change_t *param_change) {
+  (*(nts1_param_change_handler *)ctx)(param_change);
+}
+
+template <typename Table, typename Fn, typename Handler>
+static uint8_t sSetLegacyHandler(Table &table, Fn adapter, Handler &slot, Handler handler) {
+  table.unsubscribe(adapter, &slot);
+  slot = nullptr;
+  if (handler == nullptr)
+    return NTS1::STATUS_OK;
+  if (!table.subscribe(adapter, &slot, NTS1::PRIORITY_DEFAULT))
+    return NTS1::STATUS_BUSY; // table full, the handler would never be called
+  slot = handler;
+  return NTS1::STATUS_OK;
+}
 
 NTS1::NTS1(void)
+  : mNoteOffEventHandler(nullptr), mNoteOnEventHandler(nullptr),
+    mStepTickEventHandler(nullptr), mUnitDescEventHandler(nullptr),
+    mEditParamDescEventHandler(nullptr), mValueEventHandler(nullptr),
+    mParamChangeHandler(nullptr), mPendingRequests(), mRequestStats()
 {
-  sNts1Instance = this;
+  nts1_link_setup(&mLink, &Dispatch::handlers, this);
 }
 
 NTS1::~NTS1(void) {
-  if (sNts1Instance == this)
-    sNts1Instance = nullptr;
+  // Releases the port, so a later NTS1 can take the SPI interrupt
+  nts1_link_teardown(&mLink);
 }
 
-void NTS1::setNoteOffEventHandler(nts1_note_off_event_handler handler) {
-  sNoteOffEventHandler = handler;
+uint8_t NTS1::idle() {
+  const uint8_t res = nts1_link_idle(&mLink);
+  expireRequests(nts1_port_timestamp(port()));
+  return res;
 }
 
-void NTS1::setNoteOnEventHandler(nts1_note_on_event_handler handler) {
-  sNoteOnEventHandler = handler;
+uint8_t NTS1::reqParamValue(uint8_t id, uint8_t subid) {
+  return requestValue(id, subid, nullptr, nullptr);
 }
 
-void NTS1::setStepTickEventHandler(nts1_step_tick_event_handler handler) {
-  sStepTickEventHandler = handler;
+uint8_t NTS1::reqParamValue(uint8_t id, uint8_t subid, ValueListener fn, void *ctx) {
+  if (fn == nullptr)
+    return STATUS_ERR;
+  return requestValue(id, subid, fn, ctx);
 }
 
-void NTS1::setUnitDescEventHandler(nts1_unit_desc_event_handler handler) {
-  sUnitDescEventHandler = handler;
+void NTS1::getRequestStats(RequestStats *stats) {
+  *stats = mRequestStats;
 }
 
-void NTS1::setEditParamDescEventHandler(nts1_edit_param_desc_event_handler handler) {
-  sEditParamDescEventHandler = handler;
+uint8_t NTS1::setNoteOffEventHandler(nts1_note_off_event_handler handler) {
+  return sSetLegacyHandler(mNoteOffListeners, &sNoteOffAdapter, mNoteOffEventHandler, handler);
 }
 
-void NTS1::setValueEventHandler(nts1_value_event_handler handler) {
-  sValueEventHandler = handler;
+uint8_t NTS1::setNoteOnEventHandler(nts1_note_on_event_handler handler) {
+  return sSetLegacyHandler(mNoteOnListeners, &sNoteOnAdapter, mNoteOnEventHandler, handler);
 }
 
-void NTS1::setParamChangeHandler(nts1_param_change_handler handler) {
-  sParamChangeHandler = handler;
+uint8_t NTS1::setStepTickEventHandler(nts1_step_tick_event_handler handler) {
+  return sSetLegacyHandler(mStepTickListeners, &sStepTickAdapter, mStepTickEventHandler, handler);
 }
 
-extern "C" __attribute__((weak))
-void nts1_handle_note_off_event(const nts1_rx_note_off_t *note_off) {
-  if (sNoteOffEventHandler != nullptr) {
-    sNoteOffEventHandler(note_off);
-  }
+uint8_t NTS1::setUnitDescEventHandler(nts1_unit_desc_event_handler handler) {
+  return sSetLegacyHandler(mUnitDescListeners, &sUnitDescAdapter, mUnitDescEventHandler, handler);
 }
 
-extern "C" __attribute__((weak))
-void nts1_handle_note_on_event(const nts1_rx_note_on_t *note_on) {
-  if (sNoteOnEventHandler != nullptr) {
-    sNoteOnEventHandler(note_on);
-  }
+uint8_t NTS1::setEditParamDescEventHandler(nts1_edit_param_desc_event_handler handler) {
+  return sSetLegacyHandler(mEditParamDescListeners, &sEditParamDescAdapter, mEditParamDescEventHandler, handler);
 }
 
-extern "C" __attribute__((weak))
-void nts1_handle_step_tick_event(void) { 
-  if (sStepTickEventHandler != nullptr) {
-    sStepTickEventHandler();
-  }
+uint8_t NTS1::setValueEventHandler(nts1_value_event_handler handler) {
+  return sSetLegacyHandler(mValueListeners, &sValueAdapter, mValueEventHandler, handler);
 }
 
-extern "C" __attribute__((weak))
-void nts1_handle_unit_desc_event(const nts1_rx_unit_desc_t *unit_desc) {
-  if (sUnitDescEventHandler != nullptr) {
-    sUnitDescEventHandler(unit_desc);
-  }
+uint8_t NTS1::setParamChangeHandler(nts1_param_change_handler handler) {
+  return sSetLegacyHandler(mParamChangeListeners, &sParamChangeAdapter, mParamChangeHandler, handler);
 }
 
-extern "C" __attribute__((weak))
-void nts1_handle_edit_param_desc_event(const nts1_rx_edit_param_desc_t *param_desc) {
-  if (sEditParamDescEventHandler != nullptr) {
-    sEditParamDescEventHandler(param_desc);
-  }
-}
+// ----------------------------------------------------------
 
-extern "C" __attribute__((weak))
-void nts1_handle_value_event(const nts1_rx_value_t *value) {
-  if (sValueEventHandler != nullptr) {
-    sValueEventHandler(value);
+#define NTS1_SUBSCRIPTION(Listener, table)                                  \
+  uint8_t NTS1::subscribe(Listener fn, void *ctx, uint8_t priority) {       \
+    if (fn == nullptr)                                                      \
+      return STATUS_ERR;                                                    \
+    return table.subscribe(fn, ctx, priority) ? STATUS_OK : STATUS_BUSY;    \
+  }                                                                         \
+  uint8_t NTS1::unsubscribe(Listener fn, void *ctx) {                       \
+    return table.unsubscribe(fn, ctx) ? STATUS_OK : STATUS_ERR;             \
   }
-}
 
-extern "C" __attribute__((weak))
-void nts1_handle_param_change(const nts1_rx_param_change_t *param_change) {
-  if (sParamChangeHandler != nullptr) {
-    sParamChangeHandler(param_change);
-  }
-}
+NTS1_SUBSCRIPTION(NoteOffListener, mNoteOffListeners)
+NTS1_SUBSCRIPTION(NoteOnListener, mNoteOnListeners)
+NTS1_SUBSCRIPTION(StepTickListener, mStepTickListeners)
+NTS1_SUBSCRIPTION(UnitDescListener, mUnitDescListeners)
+NTS1_SUBSCRIPTION(EditParamDescListener, mEditParamDescListeners)
+NTS1_SUBSCRIPTION(ValueListener, mValueListeners)
+NTS1_SUBSCRIPTION(ParamChangeListener, mParamChangeListeners)
+NTS1_SUBSCRIPTION(LinkListener, mLinkListeners)
+NTS1_SUBSCRIPTION(NoteOffBatchListener, mNoteOffBatchListeners)
+NTS1_SUBSCRIPTION(NoteOnBatchListener, mNoteOnBatchListeners)
+NTS1_SUBSCRIPTION(ValueBatchListener, mValueBatchListeners)
+NTS1_SUBSCRIPTION(ParamChangeBatchListener, mParamChangeBatchListeners)
+
+#undef NTS1_SUBSCRIPTION
@@ -33,12 +33,93 @@
 #define _NTS1_H_
 
 #include "nts1_iface.h"
+#include "nts1_link.h"
+#include "nts1_trace.h"
+
+#ifndef NTS1_MAX_PENDING_REQUESTS
+#define NTS1_MAX_PENDING_REQUESTS 4
+#endif
+
+#ifndef NTS1_REQUEST_TIMEOUT_MS
+#ifdef MBED_CONF_APP_NTS1_REQUEST_TIMEOUT_MS
+#define NTS1_REQUEST_TIMEOUT_MS MBED_CONF_APP_NTS1_REQUEST_TIMEOUT_MS
+#else
+#define NTS1_REQUEST_TIMEOUT_MS 100
+#endif
+#endif
+
+#ifndef NTS1_MAX_SUBSCRIBERS
+#define NTS1_MAX_SUBSCRIBERS 4
+#endif
+
+/**
+ * Fixed capacity, allocation free subscriber table for one event type.
+ *
+ * Each entry is a (function, context) pair with a priority. Entries are kept
+ * sorted by priority (lowest value first) on insertion so that dispatch is a
+ * plain loop over a flat array.
+ */
+template <typename Fn, uint8_t N>
+class NTS1EventTable {
+ public:
+  constexpr NTS1EventTable(void) : mEntries(), mCount(0) {}
+
+  /**
+   * Add a subscriber, returns false when the table is full
+   */
+  bool subscribe(Fn fn, void *ctx, uint8_t priority) {
+    if (fn == nullptr || mCount >= N)
+      return false;
+    uint8_t i = mCount;
+    while (i > 0 && mEntries[i-1].priority > priority) {
+      mEntries[i] = mEntries[i-1];
+      --i;
+    }
+    mEntries[i].fn = fn;
+    mEntries[i].ctx = ctx;
+    mEntries[i].priority = priority;
+    ++mCount;
+    return true;
+  }
+
+  /**
+   * Remove a subscriber, returns false when it was not subscribed
+   */
+  bool unsubscribe(Fn fn, void *ctx) {
+    for (uint8_t i = 0; i < mCount; ++i) {
+      if (mEntries[i].fn == fn && mEntries[i].ctx == ctx) {
+        for (--mCount; i < mCount; ++i)
+          mEntries[i] = mEntries[i+1];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename... Args>
+  inline void dispatch(Args... args) const {
+    for (uint8_t i = 0; i < mCount; ++i)
+      mEntries[i].fn(mEntries[i].ctx, args...);
+  }
+
+  inline uint8_t count(void) const { return mCount; }
+
+ private:
+  struct Entry {
+    Fn       fn;
+    void    *ctx;
+    uint8_t  priority;
+  };
+
+  Entry   mEntries[N];
+  uint8_t mCount;
+};
 
 class NTS1 {
  public:
   
   /**
-   * Default constructor
+   * Default constructor, each object owns an independent link
    */
   NTS1(void);
 
@@ -47,6 +128,9 @@ class NTS1 {
    */
   ~NTS1(void);
 
+  NTS1(const NTS1 &) = delete;
+  NTS1 &operator=(const NTS1 &) = delete;
+
   // ----------------------------------------------------------
   
   /**
@@ -233,210 +317,545 @@ class NTS1 {
   // ----------------------------------------------------------
 
   /**
-   * Initialize main board interface
-   */  
-  static inline uint8_t init() { return nts1_init(); }
+   * Compile-time parameter descriptor
+   *
+   * Binds a parameter ID and sub ID to the range of values it accepts so
+   * that set<P>() can clamp, scale and split values into 7 bit words
+   * without runtime checks. Invalid ID/sub ID combinations fail to compile.
+   */
+  template <uint8_t Id, uint8_t SubId = 0, uint16_t Min = 0, uint16_t Max = 0x3FF>
+  struct Param {
+    static_assert(Id < NUM_PARAM_ID || (Id >= PARAM_ID_SYS_BASE && Id <= PARAM_ID_SYS_LAST),
+                  "invalid parameter ID");
+    static_assert(Id != PARAM_ID_SYS_VERSION, "system version is read-only");
+    static_assert(Id != PARAM_ID_OSC_EDIT || SubId <= PARAM_SUBID_OSC_LAST,
+                  "invalid osc edit sub ID");
+    static_assert(Id != PARAM_ID_SYS_GLOBAL || SubId <= PARAM_SUBID_SYS_GLOBAL_LAST,
+                  "invalid global parameter sub ID");
+    static_assert(Id == PARAM_ID_OSC_EDIT || Id == PARAM_ID_SYS_GLOBAL || SubId == 0,
+                  "parameter does not take a sub ID");
+    static_assert(Min <= Max && Max <= 0x3FFF, "value range must fit in 14 bits");
+
+    static constexpr uint8_t  id    = Id;
+    static constexpr uint8_t  subid = SubId;
+    static constexpr uint16_t min   = Min;
+    static constexpr uint16_t max   = Max;
+
+    /** Clamp a value to the parameter range */
+    static constexpr uint16_t clamp(uint16_t value) {
+      return (value < Min) ? Min : ((value > Max) ? Max : value);
+    }
+
+    /** Map a 10 bit control value (ADC, pot) onto the parameter range */
+    static constexpr uint16_t scale(uint16_t value10) {
+      return Min + (uint16_t)((((uint32_t)value10 & 0x3FFU) * (Max - Min + 1U)) >> 10);
+    }
+
+    static constexpr uint8_t msb(uint16_t value) { return (value >> 7) & 0x7F; }
+    static constexpr uint8_t lsb(uint16_t value) { return value & 0x7F; }
+  };
+
+  /**
+   * Typed parameters
+   *
+   * Continuous parameters take 10 bit values, type selectors take an index.
+   * Parameters whose range depends on the loaded unit accept the full
+   * 14 bit range carried by the protocol.
+   */
+  typedef Param<PARAM_ID_OSC_TYPE, 0, 0, 0x7F>        OscType;
+  typedef Param<PARAM_ID_OSC_SHAPE>                   OscShape;
+  typedef Param<PARAM_ID_OSC_SHIFT_SHAPE>             OscShiftShape;
+  typedef Param<PARAM_ID_OSC_LFO_RATE>                OscLfoRate;
+  typedef Param<PARAM_ID_OSC_LFO_DEPTH>               OscLfoDepth;
+  template <uint8_t SubId>
+  using OscEdit = Param<PARAM_ID_OSC_EDIT, SubId, 0, 0x3FFF>;
+
+  typedef Param<PARAM_ID_AMPEG_TYPE, 0, 0, 0x7F>      AmpEGType;
+  typedef Param<PARAM_ID_AMPEG_ATTACK>                AmpEGAttack;
+  typedef Param<PARAM_ID_AMPEG_RELEASE>               AmpEGRelease;
+  typedef Param<PARAM_ID_AMPEG_LFO_RATE>              AmpEGLfoRate;
+  typedef Param<PARAM_ID_AMPEG_LFO_DEPTH>             AmpEGLfoDepth;
+
+  typedef Param<PARAM_ID_FILT_TYPE, 0, 0, 0x7F>       FiltType;
+  typedef Param<PARAM_ID_FILT_CUTOFF>                 FiltCutoff;
+  typedef Param<PARAM_ID_FILT_PEAK>                   FiltPeak;
+  typedef Param<PARAM_ID_FILT_LFO_RATE>               FiltLfoRate;
+  typedef Param<PARAM_ID_FILT_LFO_DEPTH>              FiltLfoDepth;
+
+  typedef Param<PARAM_ID_MOD_TYPE, 0, 0, 0x7F>        ModType;
+  typedef Param<PARAM_ID_MOD_TIME>                    ModTime;
+  typedef Param<PARAM_ID_MOD_DEPTH>                   ModDepth;
+
+  typedef Param<PARAM_ID_DEL_TYPE, 0, 0, 0x7F>        DelType;
+  typedef Param<PARAM_ID_DEL_TIME>                    DelTime;
+  typedef Param<PARAM_ID_DEL_DEPTH>                   DelDepth;
+  typedef Param<PARAM_ID_DEL_MIX>                     DelMix;
+
+  typedef Param<PARAM_ID_REV_TYPE, 0, 0, 0x7F>        RevType;
+  typedef Param<PARAM_ID_REV_TIME>                    RevTime;
+  typedef Param<PARAM_ID_REV_DEPTH>                   RevDepth;
+  typedef Param<PARAM_ID_REV_MIX>                     RevMix;
+
+  typedef Param<PARAM_ID_ARP_PATTERN, 0, 0, 0x7F>     ArpPattern;
+  typedef Param<PARAM_ID_ARP_INTERVALS, 0, 0, 0x7F>   ArpIntervals;
+  typedef Param<PARAM_ID_ARP_LENGTH, 0, 0, 0x3FFF>    ArpLength;
+  typedef Param<PARAM_ID_ARP_STATE, 0, 0, 0x3FFF>     ArpState;
+  typedef Param<PARAM_ID_ARP_TEMPO, 0, 0, 0x3FFF>     ArpTempo;
+
+  template <uint8_t SubId>
+  using SysGlobal = Param<PARAM_ID_SYS_GLOBAL, SubId, 0, 0x3FFF>;
+
+  // ----------------------------------------------------------
+
+  /**
+   * Initialize main board interface. Returns STATUS_BUSY when another
+   * NTS1 object already owns the SPI port; the destructor releases it.
+   */
+  inline uint8_t init() { return nts1_link_init(&mLink); }
 
   /**
    * Tear down main board interface
    */  
-  static inline uint8_t teardown() { return nts1_teardown(); }
+  inline uint8_t teardown() { return nts1_link_teardown(&mLink); }
 
   /**
    * Process tx/rx communications with main board
    * Must be called regularly from the loop() function. 
+   * Also times out value requests that got no reply.
    */  
-  static inline uint8_t idle() { return nts1_idle(); }
+  uint8_t idle();
+
+  /**
+   * Read ring buffer sizes, high-water marks and overflow counters
+   */
+  inline void getBufStats(nts1_buf_stats_t *stats) { nts1_link_get_buf_stats(&mLink, stats); }
+
+  /**
+   * Clear high-water marks and overflow counters
+   */
+  inline void resetBufStats(void) { nts1_link_reset_buf_stats(&mLink); }
+
+  /**
+   * Read link watchdog state, loss counters and time-to-recover
+   */
+  inline void getLinkStats(nts1_link_stats_t *stats) { nts1_link_get_stats(&mLink, stats); }
+
+  /**
+   * Bytes that can be queued for the main board right now
+   */
+  inline uint16_t txFree(void) { return nts1_link_get_tx_free(&mLink); }
+
+#if NTS1_ISR_STATS
+  /**
+   * Read link ISR cost: cycles per entry, bytes per entry, budget overruns
+   */
+  inline void getIsrStats(nts1_isr_stats_t *stats) { nts1_link_get_isr_stats(&mLink, stats); }
+
+  /**
+   * Clear the link ISR measurements
+   */
+  inline void resetIsrStats(void) { nts1_link_reset_isr_stats(&mLink); }
+#endif
+
+#if NTS1_TRACE_LATENCY
+  /**
+   * Read wire-to-handler (RX) or enqueue-to-wire (TX) latency of one
+   * message type, see k_nts1_trace_* in nts1_trace.h
+   */
+  inline void getLatency(uint8_t type, nts1_trace_summary_t *summary) { nts1_trace_get_summary(&mLink, type, summary); }
+
+  /**
+   * Clear the latency histograms
+   */
+  inline void resetLatency(void) { nts1_trace_reset(&mLink); }
+
+  /**
+   * Print the latency histograms of all message types seen so far
+   */
+  inline void printLatency(void) { nts1_trace_print(&mLink); }
+#endif
 
   /**
    * Send a parameter change message to the NTS-1 main board
    */  
-  static inline uint8_t paramChange(uint8_t id, uint8_t subid, uint16_t value) {
-    return nts1_param_change(id, subid, value);
+  inline uint8_t paramChange(uint8_t id, uint8_t subid, uint16_t value) {
+    return nts1_link_param_change(&mLink, id, subid, value);
+  }
+
+  /**
+   * Send a typed parameter change, value is clamped to the parameter range
+   */
+  template <class P>
+  inline uint8_t set(uint16_t value) {
+    const uint16_t v = P::clamp(value);
+    nts1_tx_param_change_t param = { P::id, P::subid, P::msb(v), P::lsb(v) };
+    return nts1_link_send_param_change(&mLink, &param);
+  }
+
+  /**
+   * Send a fixed typed parameter value, encoded to constant bytes
+   */
+  template <class P, uint16_t Value>
+  inline uint8_t set(void) {
+    static_assert(Value >= P::min && Value <= P::max, "value out of parameter range");
+    nts1_tx_param_change_t param = { P::id, P::subid, P::msb(Value), P::lsb(Value) };
+    return nts1_link_send_param_change(&mLink, &param);
+  }
+
+  /**
+   * Send a typed parameter change from a 10 bit control value (ADC, pot)
+   */
+  template <class P>
+  inline uint8_t setScaled(uint16_t value10) {
+    const uint16_t v = P::scale(value10);
+    nts1_tx_param_change_t param = { P::id, P::subid, P::msb(v), P::lsb(v) };
+    return nts1_link_send_param_change(&mLink, &param);
   }
 
   /**
    * Send a note on event to the NTS-1 main board
    */  
-  static inline uint8_t noteOn(uint8_t note, uint8_t velo) {
-    return nts1_note_on(note, velo);
+  inline uint8_t noteOn(uint8_t note, uint8_t velo) {
+    return nts1_link_note_on(&mLink, note, velo);
   }
 
   /**
    * Send a note off event to the NTS-1 main board
    */  
-  static inline uint8_t noteOff(uint8_t note) {
-    return nts1_note_off(note);
+  inline uint8_t noteOff(uint8_t note) {
+    return nts1_link_note_off(&mLink, note);
   }
   
   /**
    * Request system version from the NTS-1 main board
    */  
-  static inline uint8_t reqSysVersion(void) {
-    return nts1_req_sys_version();
+  inline uint8_t reqSysVersion(void) {
+    return nts1_link_req_sys_version(&mLink);
   }
 
   /**
-   * Request value of given parameter from the NTS-1 main board
+   * Request value of given parameter from the NTS-1 main board.
+   * An identical request still waiting for its reply is not sent again,
+   * the one reply answers both.
    */  
-  static inline uint8_t reqParamValue(uint8_t id, uint8_t subid) {
-    return nts1_req_param_value(id, subid);
-  }
+  uint8_t reqParamValue(uint8_t id, uint8_t subid);
   
   /**
    * Request number of oscillators from the NTS-1 main board
    */  
-  static inline uint8_t reqOscCount(void) {
-    return nts1_req_osc_count();
+  inline uint8_t reqOscCount(void) {
+    return nts1_link_req_osc_count(&mLink);
   }
 
   /**
    * Request oscillator descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqOscDesc(uint8_t idx) {
-    return nts1_req_osc_desc(idx);
+  inline uint8_t reqOscDesc(uint8_t idx) {
+    return nts1_link_req_osc_desc(&mLink, idx);
   }
 
   /**
    * Request oscillator edit parameter descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqOscEditParamDesc(uint8_t idx) {
-    return nts1_req_osc_edit_param_desc(idx);
+  inline uint8_t reqOscEditParamDesc(uint8_t idx) {
+    return nts1_link_req_osc_edit_param_desc(&mLink, idx);
   }  
 
   /**
    * Request number of filters from the NTS-1 main board
    */  
-  static inline uint8_t reqFilterCount(void) {
-    return nts1_req_filt_count();
+  inline uint8_t reqFilterCount(void) {
+    return nts1_link_req_filt_count(&mLink);
   }
 
   /**
    * Request filter descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqFilterDesc(uint8_t idx) {
-    return nts1_req_filt_desc(idx);
+  inline uint8_t reqFilterDesc(uint8_t idx) {
+    return nts1_link_req_filt_desc(&mLink, idx);
   }
   
   /**
    * Request number of amp. env. generators from the NTS-1 main board
    */  
-  static inline uint8_t reqAmpEGCount(void) {
-    return nts1_req_ampeg_count();
+  inline uint8_t reqAmpEGCount(void) {
+    return nts1_link_req_ampeg_count(&mLink);
   }
 
   /**
    * Request amp. env. generator descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqAmpEGDesc(uint8_t idx) {
-    return nts1_req_ampeg_desc(idx);
+  inline uint8_t reqAmpEGDesc(uint8_t idx) {
+    return nts1_link_req_ampeg_desc(&mLink, idx);
   }
   
   /**
    * Request number of modulation effects from the NTS-1 main board
    */  
-  static inline uint8_t reqModCount(void) {
-    return nts1_req_mod_count();
+  inline uint8_t reqModCount(void) {
+    return nts1_link_req_mod_count(&mLink);
   }
 
   /**
    * Request modulation effect descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqModDesc(uint8_t idx) {
-    return nts1_req_mod_desc(idx);
+  inline uint8_t reqModDesc(uint8_t idx) {
+    return nts1_link_req_mod_desc(&mLink, idx);
   }
 
   /**
    * Request number of delay effects from the NTS-1 main board
    */  
-  static inline uint8_t reqDelayCount(void) {
-    return nts1_req_del_count();
+  inline uint8_t reqDelayCount(void) {
+    return nts1_link_req_del_count(&mLink);
   }
 
   /**
    * Request delay effect descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqDelayDesc(uint8_t idx) {
-    return nts1_req_del_desc(idx);
+  inline uint8_t reqDelayDesc(uint8_t idx) {
+    return nts1_link_req_del_desc(&mLink, idx);
   }
 
   /**
    * Request number of reverb effects from the NTS-1 main board
    */
-  static inline uint8_t reqReverbCount(void) {
-    return nts1_req_rev_count();
+  inline uint8_t reqReverbCount(void) {
+    return nts1_link_req_rev_count(&mLink);
   }
 
   /**
    * Request reverb effect descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqReverbDesc(uint8_t idx) {
-    return nts1_req_rev_desc(idx);
+  inline uint8_t reqReverbDesc(uint8_t idx) {
+    return nts1_link_req_rev_desc(&mLink, idx);
   }
 
   /**
    * Request number of arp. patterns from the NTS-1 main board
    */
-  static inline uint8_t reqArpPatternCount(void) {
-    return nts1_req_arp_pattern_count();
+  inline uint8_t reqArpPatternCount(void) {
+    return nts1_link_req_arp_pattern_count(&mLink);
   }
 
   /**
    * Request arp. pattern descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqArpPatternDesc(uint8_t idx) {
-    return nts1_req_arp_pattern_desc(idx);
+  inline uint8_t reqArpPatternDesc(uint8_t idx) {
+    return nts1_link_req_arp_pattern_desc(&mLink, idx);
   }
 
   /**
    * Request number of arp. intervalss from the NTS-1 main board
    */
-  static inline uint8_t reqArpIntervalsCount(void) {
-    return nts1_req_arp_intervals_count();
+  inline uint8_t reqArpIntervalsCount(void) {
+    return nts1_link_req_arp_intervals_count(&mLink);
   }
 
   /**
    * Request arp. intervals descriptor from the NTS-1 main board
    */  
-  static inline uint8_t reqArpIntervalsDesc(uint8_t idx) {
-    return nts1_req_arp_intervals_desc(idx);
+  inline uint8_t reqArpIntervalsDesc(uint8_t idx) {
+    return nts1_link_req_arp_intervals_desc(&mLink, idx);
   }
   
   /**
-   * Register a handler function for received note off events
+   * Register a handler function for received note off events.
+   * The set*Handler() functions take one slot of the event's listener
+   * table; they return STATUS_BUSY and register nothing when it is full.
    */  
-  void setNoteOffEventHandler(nts1_note_off_event_handler handler);
+  uint8_t setNoteOffEventHandler(nts1_note_off_event_handler handler);
 
   /**
    * Register a handler function for received note on events
    */  
-  void setNoteOnEventHandler(nts1_note_on_event_handler handler);
+  uint8_t setNoteOnEventHandler(nts1_note_on_event_handler handler);
 
   /**
    * Register a handler function for received step tick events
    */  
-  void setStepTickEventHandler(nts1_step_tick_event_handler handler);
+  uint8_t setStepTickEventHandler(nts1_step_tick_event_handler handler);
 
   /**
    * Register a handler function for received unit descriptor events
    */
-  void setUnitDescEventHandler(nts1_unit_desc_event_handler handler);
+  uint8_t setUnitDescEventHandler(nts1_unit_desc_event_handler handler);
 
   /**
    * Register a handler function for received edit parameter descriptor events
    */  
-  void setEditParamDescEventHandler(nts1_edit_param_desc_event_handler handler);
+  uint8_t setEditParamDescEventHandler(nts1_edit_param_desc_event_handler handler);
 
   /**
    * Register a handler function for received value events
    */  
-  void setValueEventHandler(nts1_value_event_handler handler);
+  uint8_t setValueEventHandler(nts1_value_event_handler handler);
 
   /**
    * Register a handler function for received parameter change messages
    */  
-  void setParamChangeHandler(nts1_param_change_handler handler);
-  
+  uint8_t setParamChangeHandler(nts1_param_change_handler handler);
+
+  // ----------------------------------------------------------
+
+  /**
+   * Event listeners, called with the context pointer given at subscription
+   */
+  typedef void (*NoteOffListener)(void *ctx, const nts1_rx_note_off_t *note_off);
+  typedef void (*NoteOnListener)(void *ctx, const nts1_rx_note_on_t *note_on);
+  typedef void (*StepTickListener)(void *ctx);
+  typedef void (*UnitDescListener)(void *ctx, const nts1_rx_unit_desc_t *unit_desc);
+  typedef void (*EditParamDescListener)(void *ctx, const nts1_rx_edit_param_desc_t *param_desc);
+  typedef void (*ValueListener)(void *ctx, const nts1_rx_value_t *value);
+  typedef void (*ParamChangeListener)(void *ctx, const nts1_rx_param_change_t *param_change);
+  typedef void (*LinkListener)(void *ctx, nts1_link_event_t event);
+
+  /**
+   * Batch listeners, called once per run of events of one type when that
+   * type is enabled with setRxBatchMask(). Without a batch listener the
+   * batch is handed to the single event listeners one by one.
+   */
+  typedef void (*NoteOffBatchListener)(void *ctx, const nts1_rx_note_off_t *note_offs, uint8_t count);
+  typedef void (*NoteOnBatchListener)(void *ctx, const nts1_rx_note_on_t *note_ons, uint8_t count);
+  typedef void (*ValueBatchListener)(void *ctx, const nts1_rx_value_t *values, uint8_t count);
+  typedef void (*ParamChangeBatchListener)(void *ctx, const nts1_rx_param_change_t *param_changes, uint8_t count);
+
+  /**
+   * Listener priorities, lower values are called first
+   */
+  enum {
+        PRIORITY_HIGH    = 0x00U,
+        PRIORITY_DEFAULT = 0x80U,
+        PRIORITY_LOW     = 0xFFU,
+  };
+
+  /**
+   * Subscribe a listener to received events.
+   * Returns STATUS_BUSY when the table for that event type is full.
+   */
+  uint8_t subscribe(NoteOffListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(NoteOnListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(StepTickListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(UnitDescListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(EditParamDescListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(ValueListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(ParamChangeListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(LinkListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(NoteOffBatchListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(NoteOnBatchListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(ValueBatchListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+  uint8_t subscribe(ParamChangeBatchListener fn, void *ctx, uint8_t priority = PRIORITY_DEFAULT);
+
+  /**
+   * Remove a previously subscribed (listener, context) pair
+   */
+  uint8_t unsubscribe(NoteOffListener fn, void *ctx);
+  uint8_t unsubscribe(NoteOnListener fn, void *ctx);
+  uint8_t unsubscribe(StepTickListener fn, void *ctx);
+  uint8_t unsubscribe(UnitDescListener fn, void *ctx);
+  uint8_t unsubscribe(EditParamDescListener fn, void *ctx);
+  uint8_t unsubscribe(ValueListener fn, void *ctx);
+  uint8_t unsubscribe(ParamChangeListener fn, void *ctx);
+  uint8_t unsubscribe(LinkListener fn, void *ctx);
+  uint8_t unsubscribe(NoteOffBatchListener fn, void *ctx);
+  uint8_t unsubscribe(NoteOnBatchListener fn, void *ctx);
+  uint8_t unsubscribe(ValueBatchListener fn, void *ctx);
+  uint8_t unsubscribe(ParamChangeBatchListener fn, void *ctx);
+
+  /**
+   * Request value of given parameter and call fn(ctx, value) with the
+   * reply, or with value == nullptr when none came within
+   * NTS1_REQUEST_TIMEOUT_MS. Waiters on an identical outstanding request
+   * share its reply. Returns STATUS_BUSY when no request slot or waiter
+   * slot is free. Main loop only.
+   */
+  uint8_t reqParamValue(uint8_t id, uint8_t subid, ValueListener fn, void *ctx);
+
+  struct RequestStats {
+    uint32_t sent;      // value requests put on the link
+    uint32_t saved;     // requests answered by an outstanding identical one
+    uint32_t completed; // replies matched to an outstanding request
+    uint32_t timeouts;  // requests that got no reply in time
+  };
+
+  void getRequestStats(RequestStats *stats);
+
+  /**
+   * Received event types delivered in batches
+   */
+  enum {
+        RX_BATCH_NOTE_OFF     = k_nts1_rx_batch_note_off,
+        RX_BATCH_NOTE_ON      = k_nts1_rx_batch_note_on,
+        RX_BATCH_VALUE        = k_nts1_rx_batch_value,
+        RX_BATCH_PARAM_CHANGE = k_nts1_rx_batch_param_change,
+  };
+
+  /**
+   * Select the event types (RX_BATCH_*) collected into batches during
+   * idle(), 0 delivers every event on its own
+   */
+  inline void setRxBatchMask(uint8_t mask) { nts1_link_set_rx_batch_mask(&mLink, mask); }
+
+  /**
+   * Transport state of this object, for the nts1_link_* C API
+   */
+  inline nts1_link_t *link(void) { return &mLink; }
+
+  /**
+   * Transport port of this object (host simulation, critical sections)
+   */
+  inline nts1_port_t *port(void) { return &mLink.port; }
+
+ private:
+  struct Dispatch;
+
+  struct Waiter {
+    ValueListener fn;
+    void *ctx;
+  };
+
+  struct PendingRequest {
+    bool     used;
+    uint8_t  id;
+    uint8_t  subid;
+    uint8_t  waiterCount;
+    uint32_t issuedUs;
+    Waiter   waiters[NTS1_MAX_SUBSCRIBERS];
+  };
+
+  void finishRequest(PendingRequest &req, const nts1_rx_value_t *value);
+  void completeRequest(const nts1_rx_value_t *value);
+  void expireRequests(uint32_t now);
+  uint8_t requestValue(uint8_t id, uint8_t subid, ValueListener fn, void *ctx);
+
+  nts1_link_t mLink;
+
+  nts1_note_off_event_handler mNoteOffEventHandler;
+  nts1_note_on_event_handler mNoteOnEventHandler;
+  nts1_step_tick_event_handler mStepTickEventHandler;
+  nts1_unit_desc_event_handler mUnitDescEventHandler;
+  nts1_edit_param_desc_event_handler mEditParamDescEventHandler;
+  nts1_value_event_handler mValueEventHandler;
+  nts1_param_change_handler mParamChangeHandler;
+
+  NTS1EventTable<NoteOffListener, NTS1_MAX_SUBSCRIBERS> mNoteOffListeners;
+  NTS1EventTable<NoteOnListener, NTS1_MAX_SUBSCRIBERS> mNoteOnListeners;
+  NTS1EventTable<StepTickListener, NTS1_MAX_SUBSCRIBERS> mStepTickListeners;
+  NTS1EventTable<UnitDescListener, NTS1_MAX_SUBSCRIBERS> mUnitDescListeners;
+  NTS1EventTable<EditParamDescListener, NTS1_MAX_SUBSCRIBERS> mEditParamDescListeners;
+  NTS1EventTable<ValueListener, NTS1_MAX_SUBSCRIBERS> mValueListeners;
+  NTS1EventTable<ParamChangeListener, NTS1_MAX_SUBSCRIBERS> mParamChangeListeners;
+  NTS1EventTable<LinkListener, NTS1_MAX_SUBSCRIBERS> mLinkListeners;
+  NTS1EventTable<NoteOffBatchListener, NTS1_MAX_SUBSCRIBERS> mNoteOffBatchListeners;
+  NTS1EventTable<NoteOnBatchListener, NTS1_MAX_SUBSCRIBERS> mNoteOnBatchListeners;
+  NTS1EventTable<ValueBatchListener, NTS1_MAX_SUBSCRIBERS> mValueBatchListeners;
+  NTS1EventTable<ParamChangeBatchListener, NTS1_MAX_SUBSCRIBERS> mParamChangeBatchListeners;
+
+  // Outstanding parameter value requests, each reply completes every
+  // waiter of the matching (id, subid)
+  PendingRequest mPendingRequests[NTS1_MAX_PENDING_REQUESTS];
+  RequestStats mRequestStats;
+
 };
 
 #endif // _NTS1_H_
@@ -32,52 +32,56 @@
  //*/
 
 #include "nts1_iface.h"
+#include "nts1_link.h"
+#include "nts1_port.h"
+#include "nts1_trace.h"
 
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
 
-#include "stm32f0xx_hal.h"
-#include "stm32f0xx_hal_def.h"
-#include "stm32f0xx_hal_spi.h"
-
-// #include "stm32_def.h"
-#include "PeripheralPins.h"
-//#include "PinAF_STM32F1.h"
-//#include "pinconfig.h"
-//#include "spi_com.h"
+#define PANEL_ID_MASK    0x38  // Bits 3-5
+#define PANEL_CMD_EMARK  0x40  // Bit  6
+#define PANEL_START_BIT  0x80  // Bit  7
 
-#define SPI_PERIPH       SPI2
-#define SPI_MISO_PORT    GPIOB
-#define SPI_MISO_PIN     GPIO_PIN_14
-#define SPI_MOSI_PORT    GPIOB
-#define SPI_MOSI_PIN     GPIO_PIN_15
-#define SPI_SCK_PORT     GPIOB
-#define SPI_SCK_PIN      GPIO_PIN_13
-#define SPI_GPIO_AF      GPIO_AF0_SPI2
+#define SPI_TX_BUF_SIZE NTS1_LINK_TX_BUF_SIZE
+#define SPI_TX_BUF_MASK (SPI_TX_BUF_SIZE - 1)
+#define SPI_RX_BUF_SIZE NTS1_LINK_RX_BUF_SIZE
+#define SPI_RX_BUF_MASK (SPI_RX_BUF_SIZE - 1)
 
-#define SPI_IRQn         SPI2_IRQn
-#define SPI_IRQ_PRIORITY 1
-#define SPI_IRQ_HANDLER  SPI2_IRQHandler
+// Link is considered lost when no valid frame arrives for this long
+#ifdef MBED_CONF_APP_NTS1_LINK_TIMEOUT_MS
+#define LINK_TIMEOUT_US ((uint32_t)(MBED_CONF_APP_NTS1_LINK_TIMEOUT_MS) * 1000U)
+#else
+#define LINK_TIMEOUT_US (1000U * 1000U)
+#endif
 
-#define SPI_GPIO_CLK_ENA()   __HAL_RCC_GPIOB_CLK_ENABLE()
-#define SPI_FORCE_RESET()    __HAL_RCC_SPI2_FORCE_RESET()
-#define SPI_RELEASE_RESET()  __HAL_RCC_SPI2_RELEASE_RESET()
-#define SPI_CLK_ENABLE()     __HAL_RCC_SPI2_CLK_ENABLE()
-#define SPI_CLK_DISABLE()    __HAL_RCC_SPI2_CLK_DISABLE()
+// Link ISR budget: bytes per second the main board clocks at most, and
+// the share of each byte time the ISR may take
+#ifdef MBED_CONF_APP_NTS1_LINK_BYTE_RATE
+#define LINK_BYTE_RATE MBED_CONF_APP_NTS1_LINK_BYTE_RATE
+#else
+#define LINK_BYTE_RATE 125000
+#endif
+#ifdef MBED_CONF_APP_NTS1_ISR_LOAD_PCT
+#define ISR_LOAD_PCT MBED_CONF_APP_NTS1_ISR_LOAD_PCT
+#else
+#define ISR_LOAD_PCT 50
+#endif
+#define ISR_BUDGET_CYCLES ((NTS1_PORT_CORE_HZ / (LINK_BYTE_RATE)) * (ISR_LOAD_PCT) / 100)
 
-#define ACK_PORT         GPIOB
-#define ACK_PIN          GPIO_PIN_12
+#ifdef NTS1_PORT_ISR_WORST_CYCLES
+#if NTS1_PORT_ISR_WORST_CYCLES > ISR_BUDGET_CYCLES
+#error "NTS-1 link ISR worst path exceeds its cycle budget at nts1-link-byte-rate, lower the rate or raise nts1-isr-load-pct"
+#endif
+#endif
 
-#define ACK_GPIO_CLK_ENABLE() __HAL_RCC_GPIOB_CLK_ENABLE()
+#define RX_BATCH_SIZE NTS1_LINK_RX_BATCH_SIZE
 
-#define PANEL_ID_MASK    0x38  // Bits 3-5
-#define PANEL_CMD_EMARK  0x40  // Bit  6
-#define PANEL_START_BIT  0x80  // Bit  7
+#define PARAM_SLOTS      NTS1_LINK_PARAM_SLOTS
+#define PARAM_SLOT_WORDS NTS1_LINK_PARAM_SLOT_WORDS
 
-#define SPI_TX_BUF_SIZE (0x200)
-#define SPI_TX_BUF_MASK (SPI_TX_BUF_SIZE - 1)
-
-#define SPI_RX_BUF_SIZE (0x200 )
-#define SPI_RX_BUF_MASK (SPI_RX_BUF_SIZE - 1)
+#define RX_EVENT_MAX_DECODE_SIZE NTS1_LINK_RX_DECODE_SIZE
 
 #ifndef true 
 #define true 1
@@ -124,304 +128,446 @@ typedef struct __nts1_cmd_header {
 
 // ----------------------------------------------------
 
-static SPI_HandleTypeDef s_spi;
-
-static uint8_t  s_panel_id = PANEL_ID_MASK; // Bits 3-5 "ppp"="111"
-static uint8_t  s_dummy_tx_cmd = (PANEL_ID_MASK + 0xC7); // B'11ppp111;
-
-static uint8_t  s_started;
-
-static uint8_t  s_spi_tx_buf[SPI_TX_BUF_SIZE];
-static uint16_t s_spi_tx_ridx;  // Read  Index (from s_spi_tx_buf)
-static uint16_t s_spi_tx_widx;  // Write Index (to s_spi_tx_buf)
-
-static uint8_t  s_spi_rx_buf[SPI_RX_BUF_SIZE];
-static uint16_t s_spi_rx_ridx;  // Read  Index (from s_spi_rx_buf)
-static uint16_t s_spi_rx_widx;  // Write Index (to s_spi_rx_buf)
-
-static uint8_t  s_panel_rx_status;
-static uint8_t  s_panel_rx_data_cnt;
-static uint8_t  s_panel_rx_data[127];
+// Restore order: audible parameters first (osc incl. edit sub IDs,
+// filter, amp EG), then effects and arpeggiator
+static const struct {
+  uint8_t first;
+  uint8_t last;
+} s_restore_order[] = {
+  { k_param_id_osc_base,   k_param_id_osc_last },
+  { k_num_param_id,        PARAM_SLOTS - 1 },
+  { k_param_id_filt_base,  k_param_id_filt_last },
+  { k_param_id_ampeg_base, k_param_id_ampeg_last },
+  { k_param_id_mod_base,   k_num_param_id - 1 },
+};
 
 // ----------------------------------------------------
 
-#define SPI_TX_BUF_RESET() (s_spi_tx_ridx = s_spi_tx_widx = 0)
-#define SPI_TX_BUF_EMPTY() ((SPI_TX_BUF_MASK & s_spi_tx_ridx) == (SPI_TX_BUF_MASK & s_spi_tx_widx))
-#define SPI_RX_BUF_RESET() (s_spi_rx_ridx = s_spi_rx_widx = 0)
-#define SPI_RX_BUF_EMPTY() ((SPI_RX_BUF_MASK & s_spi_rx_ridx) == (SPI_RX_BUF_MASK & s_spi_rx_widx))
+#define SPI_TX_BUF_RESET(link) ((link)->tx_ridx = (link)->tx_widx = 0)
+#define SPI_TX_BUF_EMPTY(link) ((SPI_TX_BUF_MASK & (link)->tx_ridx) == (SPI_TX_BUF_MASK & (link)->tx_widx))
+#define SPI_RX_BUF_RESET(link) ((link)->rx_ridx = (link)->rx_widx = 0)
+#define SPI_RX_BUF_EMPTY(link) ((SPI_RX_BUF_MASK & (link)->rx_ridx) == (SPI_RX_BUF_MASK & (link)->rx_widx))
 
 #define SPI_BUF_INC(idx, bufSize) (((idx+1) == bufSize) ? 0 : idx + 1)
 
-// ----------------------------------------------------
+#define SLOT_TEST(bits, slot)  ((bits)[(slot) >> 5] & (1UL << ((slot) & 31)))
+#define SLOT_SET(bits, slot)   ((bits)[(slot) >> 5] |= (1UL << ((slot) & 31)))
+#define SLOT_CLEAR(bits, slot) ((bits)[(slot) >> 5] &= ~(1UL << ((slot) & 31)))
 
-static inline void s_port_startup_ack(void)
-{
-  ACK_PORT->BSRR = ACK_PIN;
-}
+#define HANDLE(link, name, ...) \
+  do { if ((link)->handlers->name) (link)->handlers->name((link)->handlers_ctx, __VA_ARGS__); } while (0)
+#define HANDLE0(link, name) \
+  do { if ((link)->handlers->name) (link)->handlers->name((link)->handlers_ctx); } while (0)
 
-static inline void s_port_wait_ack(void)
-{
-  ACK_PORT->BRR = ACK_PIN;
-}
+#define CRITICAL_ENTER(link)       nts1_port_critical_enter(&(link)->port)
+#define CRITICAL_EXIT(link, state) nts1_port_critical_exit(&(link)->port, state)
+#define TIMESTAMP(link)            nts1_port_timestamp(&(link)->port)
 
 // ----------------------------------------------------
 
-static inline void s_spi_raw_fifo_push8(SPI_TypeDef* SPIx, uint8_t data)
+static inline void s_port_startup_ack(nts1_link_t *link)
 {
-  const uint32_t spix_dr = (uint32_t)SPIx + 0x0C;
-  *(__IO uint8_t *) spix_dr = data;
+  nts1_port_ack_set(&link->port, true);
 }
 
-static inline uint8_t s_spi_raw_fifo_pop8(SPI_TypeDef* SPIx)
+static inline void s_port_wait_ack(nts1_link_t *link)
 {
-  const uint32_t spix_dr = (uint32_t)SPIx + 0x0C;   
-  return *(__IO uint8_t *) spix_dr;
+  nts1_port_ack_set(&link->port, false);
 }
 
-static uint8_t s_spi_chk_rx_buf_space(uint16_t size)
+// ----------------------------------------------------
+
+static uint8_t s_spi_chk_rx_buf_space(nts1_link_t *link, uint16_t size)
 {
   uint16_t count;
 
-  if (s_spi_rx_ridx <= s_spi_rx_widx) {
-    count = (SPI_RX_BUF_SIZE + s_spi_rx_ridx) - s_spi_rx_widx;
+  if (link->rx_ridx <= link->rx_widx) {
+    count = (SPI_RX_BUF_SIZE + link->rx_ridx) - link->rx_widx;
   } else {
-    count = s_spi_rx_ridx - s_spi_rx_widx;
+    count = link->rx_ridx - link->rx_widx;
   }
   return (count > size);
 }
 
-static uint8_t s_spi_rx_buf_write(uint8_t data) 
+static uint8_t s_spi_rx_buf_write(nts1_link_t *link, uint8_t data) 
 {
   uint16_t bufdatacount;
-  if (s_spi_rx_ridx <= s_spi_rx_widx) {
-    bufdatacount = s_spi_rx_widx - s_spi_rx_ridx;
+  if (link->rx_ridx <= link->rx_widx) {
+    bufdatacount = link->rx_widx - link->rx_ridx;
   } else {
-    bufdatacount = SPI_RX_BUF_SIZE + s_spi_rx_widx - s_spi_rx_ridx;
+    bufdatacount = SPI_RX_BUF_SIZE + link->rx_widx - link->rx_ridx;
   }
   if (bufdatacount < (SPI_RX_BUF_SIZE - 2)) {
-    s_spi_rx_buf[SPI_RX_BUF_MASK & s_spi_rx_widx] = data;
-    s_spi_rx_widx = SPI_BUF_INC(s_spi_rx_widx, SPI_RX_BUF_SIZE);
+    NTS1_TRACE_RX_BYTE(link, link->rx_widx, data);
+    link->rx_buf[SPI_RX_BUF_MASK & link->rx_widx] = data;
+    link->rx_widx = SPI_BUF_INC(link->rx_widx, SPI_RX_BUF_SIZE);
+    if (bufdatacount >= link->buf_stats.rx_high_water)
+      link->buf_stats.rx_high_water = bufdatacount + 1;
     return true;
   }
   return false;
 }
 
-static uint8_t s_spi_rx_buf_read(void)
+static uint8_t s_spi_rx_buf_read(nts1_link_t *link)
 {
-  const uint8_t data = s_spi_rx_buf[SPI_RX_BUF_MASK & s_spi_rx_ridx];
-  s_spi_rx_ridx = SPI_BUF_INC(s_spi_rx_ridx, SPI_RX_BUF_SIZE);
+  const uint8_t data = link->rx_buf[SPI_RX_BUF_MASK & link->rx_ridx];
+  link->rx_ridx = SPI_BUF_INC(link->rx_ridx, SPI_RX_BUF_SIZE);
   return data;
 }
 
-static uint8_t s_spi_chk_tx_buf_space(uint16_t size)
+static uint8_t s_spi_chk_tx_buf_space(nts1_link_t *link, uint16_t size)
 {
   uint16_t count;
-  if (s_spi_tx_ridx <= s_spi_tx_widx) {
-    count = SPI_TX_BUF_SIZE + s_spi_tx_ridx - s_spi_tx_widx;
+  if (link->tx_ridx <= link->tx_widx) {
+    count = SPI_TX_BUF_SIZE + link->tx_ridx - link->tx_widx;
   } else {
-    count = s_spi_tx_ridx - s_spi_tx_widx;
+    count = link->tx_ridx - link->tx_widx;
   }
-  return (count > size);
+  if (count <= size) {
+    link->buf_stats.tx_rejects++;
+    return false;
+  }
+  const uint16_t used = SPI_TX_BUF_SIZE - count + size;
+  if (used > link->buf_stats.tx_high_water)
+    link->buf_stats.tx_high_water = used;
+  return true;
 }
 
-static void s_spi_tx_buf_write(uint8_t data)
+static void s_spi_tx_buf_write(nts1_link_t *link, uint8_t data)
 {
-  s_spi_tx_buf[SPI_TX_BUF_MASK & s_spi_tx_widx] = data;
-  s_spi_tx_widx = SPI_BUF_INC(s_spi_tx_widx, SPI_TX_BUF_SIZE);
+  link->tx_buf[SPI_TX_BUF_MASK & link->tx_widx] = data;
+  link->tx_widx = SPI_BUF_INC(link->tx_widx, SPI_TX_BUF_SIZE);
 }
 
-static uint8_t s_spi_tx_buf_read(void)
+static uint8_t s_spi_tx_buf_read(nts1_link_t *link)
 {
-  const uint8_t data = s_spi_tx_buf[SPI_TX_BUF_MASK & s_spi_tx_ridx];
-  s_spi_tx_ridx = SPI_BUF_INC(s_spi_tx_ridx, SPI_TX_BUF_SIZE);
+  const uint8_t data = link->tx_buf[SPI_TX_BUF_MASK & link->tx_ridx];
+  link->tx_ridx = SPI_BUF_INC(link->tx_ridx, SPI_TX_BUF_SIZE);
   return data;
 }
 
 // ----------------------------------------------------
 
-static inline void s_spi_struct_init(SPI_InitTypeDef* SPI_InitStruct)
+static void s_link_reset(nts1_link_t *link)
 {
-  SPI_InitStruct->Mode = SPI_MODE_SLAVE;
-  SPI_InitStruct->Direction = SPI_DIRECTION_2LINES;
-  SPI_InitStruct->DataSize = SPI_DATASIZE_8BIT;
-  SPI_InitStruct->CLKPolarity = SPI_POLARITY_HIGH;
-  SPI_InitStruct->CLKPhase = SPI_PHASE_2EDGE;
-  SPI_InitStruct->NSS = SPI_NSS_SOFT;
-  SPI_InitStruct->BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
-  SPI_InitStruct->FirstBit = SPI_FIRSTBIT_LSB;
-  SPI_InitStruct->TIMode = SPI_TIMODE_DISABLE;
-  SPI_InitStruct->CRCCalculation = SPI_CRCCALCULATION_DISABLE;
-  SPI_InitStruct->CRCPolynomial = 7;
-  SPI_InitStruct->CRCLength = SPI_CRC_LENGTH_DATASIZE;
-  SPI_InitStruct->NSSPMode = SPI_NSS_PULSE_DISABLE;
+  link->panel_rx_status = 0;
+  link->panel_rx_data_cnt = 0;
+  link->rx_batch_count = 0;
+  SPI_RX_BUF_RESET(link);
+  SPI_TX_BUF_RESET(link);
+  NTS1_TRACE_TX_FLUSH(link);
+  link->wd.state = k_nts1_link_state_down;
+  link->wd.restore_pending = false;
 }
 
-static inline void s_spi_enable_pins()
+static int16_t s_param_slot(uint8_t id, uint8_t subid);
+static void s_param_forget_known(nts1_link_t *link, uint8_t slot);
+
+// Drop everything queued but not yet sent. A frame the ISR is already
+// shifting out gets cut, the main board resyncs on the next status byte.
+// Param changes dropped here never reached the main board, so their
+// slots become dirty again.
+static void s_spi_tx_flush(nts1_link_t *link)
 {
-  SPI_GPIO_CLK_ENA();
-  
-  GPIO_InitTypeDef gpio;
-  
-  /* Enable SCK, MOSI, MISO. No NSS. */
-  /* Peripherals alternate function */
-  gpio.Mode = GPIO_MODE_AF_PP;
-  /* gpio.Speed = GPIO_SPEED_FREQ_HIGH;  */ 
-  gpio.Speed = GPIO_SPEED_FREQ_LOW; 
-  
-  gpio.Pull = GPIO_NOPULL;
-  gpio.Alternate = SPI_GPIO_AF;
-  
-  gpio.Pin = SPI_MISO_PIN;
-  HAL_GPIO_Init(SPI_MISO_PORT, &gpio);
-  
-  gpio.Pin = SPI_MOSI_PIN;
-  HAL_GPIO_Init(SPI_MOSI_PORT, &gpio);
-  
-  gpio.Pin = SPI_SCK_PIN;
-  gpio.Pull = GPIO_PULLUP;
-  HAL_GPIO_Init(SPI_SCK_PORT, &gpio);
-  
+  const uint32_t state = CRITICAL_ENTER(link);
+  link->wd.stats.flushed_bytes += (SPI_TX_BUF_SIZE + link->tx_widx - link->tx_ridx) & SPI_TX_BUF_MASK;
+  uint16_t idx = link->tx_ridx;
+  while (idx != link->tx_widx) {
+    const uint8_t data = link->tx_buf[SPI_TX_BUF_MASK & idx];
+    idx = SPI_BUF_INC(idx, SPI_TX_BUF_SIZE);
+    if ((data & 0x87) != k_tx_cmd_param)
+      continue;
+    const uint8_t id = link->tx_buf[SPI_TX_BUF_MASK & idx];
+    const uint8_t subid = link->tx_buf[SPI_TX_BUF_MASK & SPI_BUF_INC(idx, SPI_TX_BUF_SIZE)];
+    const int16_t slot = s_param_slot(id, subid);
+    if (slot >= 0)
+      s_param_forget_known(link, slot);
+  }
+  link->tx_widx = link->tx_ridx;
+  NTS1_TRACE_TX_FLUSH(link);
+  CRITICAL_EXIT(link, state);
 }
 
-HAL_StatusTypeDef s_spi_init()
+// ----------------------------------------------------
+
+static int16_t s_param_slot(uint8_t id, uint8_t subid)
 {
-  __HAL_RCC_SYSCFG_CLK_ENABLE();
-  
-  s_spi_enable_pins();
-  
-  SPI_FORCE_RESET();
-  SPI_RELEASE_RESET();
-  SPI_CLK_ENABLE();
-  
-  s_spi.Instance = SPI_PERIPH;
-  s_spi_struct_init(&(s_spi.Init));
-  
-  const HAL_StatusTypeDef res = HAL_SPI_Init(&s_spi);
-  if (res != HAL_OK) {
-    return res;
+  if (id == k_param_id_osc_edit)
+    return (subid <= k_param_subid_osc_last) ? (int16_t)(k_num_param_id + subid) : -1;
+  if (id < k_num_param_id)
+    return id;
+  return -1; // system values are not restored
+}
+
+// Callers hold the critical section
+static void s_param_update_dirty(nts1_link_t *link, uint8_t slot)
+{
+  if (SLOT_TEST(link->param_desired_valid, slot)
+      && (!SLOT_TEST(link->param_known_valid, slot) || link->param_known[slot] != link->param_desired[slot]))
+    SLOT_SET(link->param_dirty, slot);
+  else
+    SLOT_CLEAR(link->param_dirty, slot);
+}
+
+static void s_param_forget_known(nts1_link_t *link, uint8_t slot)
+{
+  SLOT_CLEAR(link->param_known_valid, slot);
+  s_param_update_dirty(link, slot);
+}
+
+// The panel wants this value
+static void s_param_record(nts1_link_t *link, uint8_t id, uint8_t subid, uint16_t value)
+{
+  const int16_t slot = s_param_slot(id, subid);
+  if (slot < 0)
+    return;
+  const uint32_t state = CRITICAL_ENTER(link);
+  link->param_desired[slot] = value;
+  SLOT_SET(link->param_desired_valid, slot);
+  s_param_update_dirty(link, slot);
+  CRITICAL_EXIT(link, state);
+}
+
+// The main board holds this value: queued to it, or reported by it
+static void s_param_known_value(nts1_link_t *link, uint8_t id, uint8_t subid, uint16_t value)
+{
+  const int16_t slot = s_param_slot(id, subid);
+  if (slot < 0)
+    return;
+  const uint32_t state = CRITICAL_ENTER(link);
+  link->param_known[slot] = value;
+  SLOT_SET(link->param_known_valid, slot);
+  s_param_update_dirty(link, slot);
+  CRITICAL_EXIT(link, state);
+}
+
+// Main board restarted: assume nothing about its state
+static void s_param_forget_all_known(nts1_link_t *link)
+{
+  const uint32_t state = CRITICAL_ENTER(link);
+  for (uint8_t i = 0; i < PARAM_SLOT_WORDS; ++i) {
+    link->param_known_valid[i] = 0;
+    link->param_dirty[i] = link->param_desired_valid[i];
   }
+  CRITICAL_EXIT(link, state);
+}
 
-  HAL_NVIC_SetPriority(SPI_IRQn, SPI_IRQ_PRIORITY, 0);
-  HAL_NVIC_EnableIRQ(SPI_IRQn);
-  
-  SPI_PERIPH->CR2 |= SPI_IT_RXNE;
+static void s_link_start_restore(nts1_link_t *link, uint32_t now)
+{
+  link->wd.recover_start_us = now;
+  link->wd.restore_pending = true;
+  link->wd.stats.restored_params = 0;
+}
 
-  s_panel_rx_status = 0;
-  s_panel_rx_data_cnt = 0;
-  SPI_RX_BUF_RESET();
-  SPI_TX_BUF_RESET();
-  
-  __HAL_SPI_ENABLE(&s_spi);
+// Called for every frame that parsed completely
+static void s_link_rx_valid(nts1_link_t *link, uint8_t ackreq)
+{
+  const uint32_t now = TIMESTAMP(link);
+  link->wd.last_rx_us = now;
+  if (ackreq)
+    link->wd.last_ackreq_us = now;
+
+  if (link->wd.state == k_nts1_link_state_down) {
+    link->wd.state = k_nts1_link_state_up;
+    link->wd.last_ackreq_us = now;
+    HANDLE(link, link_event, k_nts1_link_event_up);
+  } else if (link->wd.state == k_nts1_link_state_lost) {
+    link->wd.state = k_nts1_link_state_up;
+    link->wd.last_ackreq_us = now;
+    s_link_start_restore(link, now);
+    HANDLE(link, link_event, k_nts1_link_event_restored);
+  }
+}
 
-  return HAL_OK;
+static void s_link_panel_id_assigned(nts1_link_t *link, uint8_t panel_id)
+{
+  const uint8_t changed = link->wd.panel_id_assigned && (panel_id != link->panel_id);
+  link->wd.panel_id_assigned = true;
+  if (!changed)
+    return;
+  // The main board rebooted or re-enumerated: whatever is queued was meant
+  // for the old session.
+  s_spi_tx_flush(link);
+  link->wd.stats.panel_id_changes++;
+  s_param_forget_all_known(link);
+  s_link_start_restore(link, TIMESTAMP(link));
+  HANDLE(link, link_event, k_nts1_link_event_panel_id);
 }
 
-HAL_StatusTypeDef s_spi_teardown()
+static void s_link_check_timeout(nts1_link_t *link)
 {
-  __HAL_SPI_DISABLE(&s_spi);
-  SPI_CLK_DISABLE();
-  return HAL_OK;
+  if (link->wd.state != k_nts1_link_state_up)
+    return;
+  const uint32_t now = TIMESTAMP(link);
+  if ((now - link->wd.last_rx_us) <= LINK_TIMEOUT_US)
+    return;
+  link->wd.state = k_nts1_link_state_lost;
+  link->wd.restore_pending = false;
+  link->wd.stats.lost_count++;
+  s_spi_tx_flush(link);
+  HANDLE(link, link_event, k_nts1_link_event_lost);
 }
 
 // ----------------------------------------------------
 
-static uint8_t s_tx_cmd_event(const nts1_tx_event_t *event, uint8_t endmark) 
+// Queue a whole frame. The space check and the copy run in one short
+// critical section, so frames queued from different contexts (main loop,
+// tickers, timer callbacks) never interleave on the wire.
+static uint8_t s_spi_tx_frame_write(nts1_link_t *link, const uint8_t *frame, uint8_t size)
 {
-  assert(event != NULL);
-  if (!s_spi_chk_tx_buf_space(4)) 
-     return false;
-  const uint8_t cmd = (s_panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_event | PANEL_CMD_EMARK) : k_tx_cmd_event; 
-  s_spi_tx_buf_write(cmd);
-  s_spi_tx_buf_write(event->event_id & 0x7F);
-  s_spi_tx_buf_write(event->msb & 0x7F);
-  s_spi_tx_buf_write(event->lsb & 0x7F);
+  const uint32_t state = CRITICAL_ENTER(link);
+  if (!s_spi_chk_tx_buf_space(link, size)) {
+    CRITICAL_EXIT(link, state);
+    return false;
+  }
+  for (uint8_t i = 0; i < size; ++i)
+    s_spi_tx_buf_write(link, frame[i]);
+  NTS1_TRACE_TX_QUEUED(link, k_nts1_trace_tx_event + (frame[0] & 0x07) - (k_tx_cmd_event & 0x07), link->tx_widx);
+  CRITICAL_EXIT(link, state);
   return true;
 }
 
-static uint8_t s_tx_cmd_param_change(const nts1_tx_param_change_t *param_change, uint8_t endmark) 
+static uint8_t s_tx_cmd_event(nts1_link_t *link, const nts1_tx_event_t *event, uint8_t endmark) 
+{
+  assert(event != NULL);
+  if (link->wd.state == k_nts1_link_state_lost)
+    return false; // would only be flushed again
+  const uint8_t cmd = (link->panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_event | PANEL_CMD_EMARK) : k_tx_cmd_event; 
+  const uint8_t frame[4] = {
+    cmd,
+    event->event_id & 0x7F,
+    event->msb & 0x7F,
+    event->lsb & 0x7F,
+  };
+  return s_spi_tx_frame_write(link, frame, sizeof(frame));
+}
+
+static uint8_t s_tx_cmd_param_change(nts1_link_t *link, const nts1_tx_param_change_t *param_change, uint8_t endmark) 
 {
   assert(param_change != NULL);
-  if (!s_spi_chk_tx_buf_space(4)) 
-     return false;
-  const uint8_t cmd = (s_panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_param | PANEL_CMD_EMARK) : k_tx_cmd_param; 
-  s_spi_tx_buf_write(cmd);
-  s_spi_tx_buf_write(param_change->param_id & 0x7F);
-  s_spi_tx_buf_write(param_change->param_subid & 0x7F);
-  s_spi_tx_buf_write(param_change->msb & 0x7F);
-  s_spi_tx_buf_write(param_change->lsb & 0x7F);
-  return true;
+  if (link->wd.state == k_nts1_link_state_lost)
+    return false; // restored from param_desired once the link is back
+  const uint8_t cmd = (link->panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_param | PANEL_CMD_EMARK) : k_tx_cmd_param; 
+  const uint8_t frame[5] = {
+    cmd,
+    param_change->param_id & 0x7F,
+    param_change->param_subid & 0x7F,
+    param_change->msb & 0x7F,
+    param_change->lsb & 0x7F,
+  };
+  return s_spi_tx_frame_write(link, frame, sizeof(frame));
 }
 
-static uint8_t s_tx_cmd_other_ack(uint8_t endmark) 
+static uint8_t s_tx_cmd_other_ack(nts1_link_t *link, uint8_t endmark) 
 {
-  if (!s_spi_chk_tx_buf_space(3)) 
-     return false;
-  const uint8_t cmd = (s_panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_other | PANEL_CMD_EMARK) : k_tx_cmd_other; 
-  s_spi_tx_buf_write(cmd);
-  s_spi_tx_buf_write(3);
-  s_spi_tx_buf_write(k_tx_subcmd_other_ack);
-  return true;
+  const uint8_t cmd = (link->panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_other | PANEL_CMD_EMARK) : k_tx_cmd_other; 
+  const uint8_t frame[3] = { cmd, 3, k_tx_subcmd_other_ack };
+  return s_spi_tx_frame_write(link, frame, sizeof(frame));
 }
 
-static uint8_t s_tx_cmd_other_version(uint8_t endmark) 
+static uint8_t s_tx_cmd_other_version(nts1_link_t *link, uint8_t endmark) 
 {
-  if (!s_spi_chk_tx_buf_space(5)) 
-     return false; 
-  const uint8_t cmd = (s_panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_other | PANEL_CMD_EMARK) : k_tx_cmd_other; 
-  s_spi_tx_buf_write(cmd);
-  s_spi_tx_buf_write(5);
-  s_spi_tx_buf_write(k_tx_subcmd_other_version);
-  s_spi_tx_buf_write(1);
-  s_spi_tx_buf_write(0);
-  return true;
+  const uint8_t cmd = (link->panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_other | PANEL_CMD_EMARK) : k_tx_cmd_other; 
+  const uint8_t frame[5] = { cmd, 5, k_tx_subcmd_other_version, 1, 0 };
+  return s_spi_tx_frame_write(link, frame, sizeof(frame));
 }
 
-static uint8_t s_tx_cmd_other_bootmode(uint8_t endmark) 
+static uint8_t s_tx_cmd_other_bootmode(nts1_link_t *link, uint8_t endmark) 
 {
-  if (!s_spi_chk_tx_buf_space(4))
-    return false;
-  const uint8_t cmd = (s_panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_other | PANEL_CMD_EMARK) : k_tx_cmd_other; 
-  s_spi_tx_buf_write(cmd);
-  s_spi_tx_buf_write(4);
-  s_spi_tx_buf_write(k_tx_subcmd_other_bootmode);
-  s_spi_tx_buf_write(0);
-  return true;
+  const uint8_t cmd = (link->panel_id & PANEL_ID_MASK) + (endmark) ? (k_tx_cmd_other | PANEL_CMD_EMARK) : k_tx_cmd_other; 
+  const uint8_t frame[4] = { cmd, 4, k_tx_subcmd_other_bootmode, 0 };
+  return s_spi_tx_frame_write(link, frame, sizeof(frame));
 }
 
 // ----------------------------------------------------
 
-static uint8_t s_dummy_buffer[64];
-#define RX_EVENT_MAX_DECODE_SIZE 64
-static uint8_t s_rx_event_decode_buf[RX_EVENT_MAX_DECODE_SIZE] __attribute__((aligned)) = {0};
+static void s_rx_batch_flush(nts1_link_t *link)
+{
+  const uint8_t count = link->rx_batch_count;
+  if (count == 0)
+    return;
+  link->rx_batch_count = 0;
+  const nts1_link_handlers_t *h = link->handlers;
+  void *ctx = link->handlers_ctx;
+  switch (link->rx_batch_type) {
+  case k_nts1_rx_batch_note_off:
+    if (h->note_off_batch)
+      h->note_off_batch(ctx, link->rx_batch.note_off, count);
+    else if (h->note_off)
+      for (uint8_t i = 0; i < count; ++i)
+        h->note_off(ctx, &link->rx_batch.note_off[i]);
+    break;
+  case k_nts1_rx_batch_note_on:
+    if (h->note_on_batch)
+      h->note_on_batch(ctx, link->rx_batch.note_on, count);
+    else if (h->note_on)
+      for (uint8_t i = 0; i < count; ++i)
+        h->note_on(ctx, &link->rx_batch.note_on[i]);
+    break;
+  case k_nts1_rx_batch_value:
+    if (h->value_batch)
+      h->value_batch(ctx, link->rx_batch.value, count);
+    else if (h->value)
+      for (uint8_t i = 0; i < count; ++i)
+        h->value(ctx, &link->rx_batch.value[i]);
+    break;
+  case k_nts1_rx_batch_param_change:
+    if (h->param_change_batch)
+      h->param_change_batch(ctx, link->rx_batch.param_change, count);
+    else if (h->param_change)
+      for (uint8_t i = 0; i < count; ++i)
+        h->param_change(ctx, &link->rx_batch.param_change[i]);
+    break;
+  default:
+    break;
+  }
+}
+
+// Returns false when the event type is not batched, the caller then calls
+// its handler directly. Pending batches are delivered first either way so
+// handlers see events in wire order.
+static uint8_t s_rx_batch_add(nts1_link_t *link, uint8_t type, const void *event, uint8_t size)
+{
+  if (!(link->rx_batch_mask & type)) {
+    s_rx_batch_flush(link);
+    return false;
+  }
+  if (link->rx_batch_type != type || link->rx_batch_count == RX_BATCH_SIZE)
+    s_rx_batch_flush(link);
+  link->rx_batch_type = type;
+  memcpy((uint8_t *)&link->rx_batch + (uint16_t)link->rx_batch_count * size, event, size);
+  link->rx_batch_count++;
+  return true;
+}
 
-static void s_rx_msg_handler(uint8_t data)
+static void s_rx_msg_handler(nts1_link_t *link, uint8_t data)
 {
   if (data >= 0x80) {
     // Status byte
-    s_panel_rx_data_cnt = 0;
+    link->panel_rx_data_cnt = 0;
     data &= ~PANEL_CMD_EMARK;
     if (data == 0xBEU) { // 10111110:Panel ID allocation
-      s_panel_rx_status = data & ~PANEL_ID_MASK;
-    } else if ((data & PANEL_ID_MASK) == (s_panel_id & PANEL_ID_MASK)) {
-      s_panel_rx_status = data & ~PANEL_ID_MASK;
+      link->panel_rx_status = data & ~PANEL_ID_MASK;
+    } else if ((data & PANEL_ID_MASK) == (link->panel_id & PANEL_ID_MASK)) {
+      link->panel_rx_status = data & ~PANEL_ID_MASK;
     } else {
-      s_panel_rx_status = 0;  // cancel any previous command reception
+      link->panel_rx_status = 0;  // cancel any previous command reception
     }
     return;
   }
   
   // Data byte
-  const uint8_t active_cmd = s_panel_rx_status;
+  const uint8_t active_cmd = link->panel_rx_status;
   
   switch (active_cmd) {
   case k_rx_cmd_event:
     { 
-      s_panel_rx_data[s_panel_rx_data_cnt++] = data;
+      link->panel_rx_data[link->panel_rx_data_cnt++] = data;
       
-      if (s_panel_rx_data_cnt < 2) 
+      if (link->panel_rx_data_cnt < 2) 
         break; // need more data
       
-      if (s_panel_rx_data_cnt < (s_panel_rx_data[0] - 1)) 
+      if (link->panel_rx_data_cnt < (link->panel_rx_data[0] - 1)) 
         break; // need more data
       
       /*++++++++++++++++++++++++++++++++++++++++++++++
@@ -434,59 +580,75 @@ static void s_rx_msg_handler(uint8_t data)
         +++++++++++++++++++++++++++++++++++++++++++++*/
 
       
-      const nts1_rx_event_header_t *rx_event = (const nts1_rx_event_header_t *)s_panel_rx_data;
-      const uint8_t *payload = s_panel_rx_data + sizeof(nts1_rx_event_header_t);
+      const nts1_rx_event_header_t *rx_event = (const nts1_rx_event_header_t *)link->panel_rx_data;
+      const uint8_t *payload = link->panel_rx_data + sizeof(nts1_rx_event_header_t);
 
       const uint32_t payload_size7 = (rx_event->size - sizeof(nts1_rx_event_header_t) - 1);
       const uint32_t payload_size8 = nts1_size_7to8(payload_size7);
       if (payload_size8 > RX_EVENT_MAX_DECODE_SIZE) {
         // Reset rx status
-        s_panel_rx_status = 0;
-        s_panel_rx_data_cnt = 0;
+        link->panel_rx_status = 0;
+        link->panel_rx_data_cnt = 0;
         break;
       }
-      nts1_convert_7to8(s_rx_event_decode_buf, payload, payload_size7);
+      nts1_convert_7to8(link->rx_event_decode_buf, payload, payload_size7);
+      s_link_rx_valid(link, false);
       
       switch (rx_event->event_id) {
       case k_nts1_rx_event_id_note_off:
-        if (payload_size8 == sizeof(nts1_rx_note_off_t))
-          nts1_handle_note_off_event((const nts1_rx_note_off_t *)s_rx_event_decode_buf);
+        if (payload_size8 == sizeof(nts1_rx_note_off_t)) {
+          NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_note_off);
+          if (!s_rx_batch_add(link, k_nts1_rx_batch_note_off, link->rx_event_decode_buf, sizeof(nts1_rx_note_off_t)))
+            HANDLE(link, note_off, (const nts1_rx_note_off_t *)link->rx_event_decode_buf);
+        }
         break;
       case k_nts1_rx_event_id_note_on:
-        if (payload_size8 == sizeof(nts1_rx_note_on_t))
-          nts1_handle_note_on_event((const nts1_rx_note_on_t *)s_rx_event_decode_buf);
+        if (payload_size8 == sizeof(nts1_rx_note_on_t)) {
+          NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_note_on);
+          if (!s_rx_batch_add(link, k_nts1_rx_batch_note_on, link->rx_event_decode_buf, sizeof(nts1_rx_note_on_t)))
+            HANDLE(link, note_on, (const nts1_rx_note_on_t *)link->rx_event_decode_buf);
+        }
         break;
       case k_nts1_rx_event_id_step_tick:
-        nts1_handle_step_tick_event();
+        NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_step_tick);
+        s_rx_batch_flush(link);
+        HANDLE0(link, step_tick);
         break;
       case k_nts1_rx_event_id_unit_desc:
         //if (payload_size8 == sizeof(nts1_rx_unit_desc_t))
-          nts1_handle_unit_desc_event((const nts1_rx_unit_desc_t *)s_rx_event_decode_buf);
+          NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_unit_desc);
+          s_rx_batch_flush(link);
+          HANDLE(link, unit_desc, (const nts1_rx_unit_desc_t *)link->rx_event_decode_buf);
         break;
       case k_nts1_rx_event_id_edit_param_desc:
         if (payload_size8 == sizeof(nts1_rx_edit_param_desc_t)) {
-          nts1_handle_edit_param_desc_event((const nts1_rx_edit_param_desc_t *)s_rx_event_decode_buf);
+          NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_edit_param_desc);
+          s_rx_batch_flush(link);
+          HANDLE(link, edit_param_desc, (const nts1_rx_edit_param_desc_t *)link->rx_event_decode_buf);
         }
         break;
       case k_nts1_rx_event_id_value:
-        if (payload_size8 == sizeof(nts1_rx_value_t))
-          nts1_handle_value_event((const nts1_rx_value_t *)s_rx_event_decode_buf);
+        if (payload_size8 == sizeof(nts1_rx_value_t)) {
+          NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_value);
+          if (!s_rx_batch_add(link, k_nts1_rx_batch_value, link->rx_event_decode_buf, sizeof(nts1_rx_value_t)))
+            HANDLE(link, value, (const nts1_rx_value_t *)link->rx_event_decode_buf);
+        }
         break;
       default:
         break;
       }
       
       // Reset rx status
-      s_panel_rx_status = 0;
-      s_panel_rx_data_cnt = 0;
+      link->panel_rx_status = 0;
+      link->panel_rx_data_cnt = 0;
     }
     break;
 
   case k_rx_cmd_param:
     {
-      s_panel_rx_data[s_panel_rx_data_cnt++] = data;
+      link->panel_rx_data[link->panel_rx_data_cnt++] = data;
 
-      if (s_panel_rx_data_cnt < 4)
+      if (link->panel_rx_data_cnt < 4)
         break; // need more data
 
       /*++++++++++++++++++++++++++++++++++++++++++++++
@@ -498,29 +660,34 @@ static void s_rx_msg_handler(uint8_t data)
         5th    :[0][lllllll] LSB
         +++++++++++++++++++++++++++++++++++++++++++++*/
 
-      const nts1_rx_param_change_t *rx_param = (const nts1_rx_param_change_t *)s_panel_rx_data;
-      nts1_handle_param_change(rx_param);
+      const nts1_rx_param_change_t *rx_param = (const nts1_rx_param_change_t *)link->panel_rx_data;
+      s_link_rx_valid(link, false);
+      s_param_known_value(link, rx_param->param_id, rx_param->param_subid,
+                                ((rx_param->msb & 0x7F) << 7) | (rx_param->lsb & 0x7F));
+      NTS1_TRACE_RX_DISPATCH(link, k_nts1_trace_rx_param_change);
+      if (!s_rx_batch_add(link, k_nts1_rx_batch_param_change, rx_param, sizeof(nts1_rx_param_change_t)))
+        HANDLE(link, param_change, rx_param);
       
       // Reset rx status
-      s_panel_rx_status = 0;
-      s_panel_rx_data_cnt = 0;
+      link->panel_rx_status = 0;
+      link->panel_rx_data_cnt = 0;
     }
     break;
     
   case k_rx_cmd_other:
     {
-      s_panel_rx_data[s_panel_rx_data_cnt++] = data;
-      if (s_panel_rx_data_cnt < (s_panel_rx_data[0] - 1)) 
+      link->panel_rx_data[link->panel_rx_data_cnt++] = data;
+      if (link->panel_rx_data_cnt < (link->panel_rx_data[0] - 1)) 
         break; // need more data
 
-      if (s_panel_rx_data_cnt < 2) {
+      if (link->panel_rx_data_cnt < 2) {
         // Command too short - ignore and reset
-        s_panel_rx_status = 0;
-        s_panel_rx_data_cnt = 0;
+        link->panel_rx_status = 0;
+        link->panel_rx_data_cnt = 0;
         break;
       }
         
-      switch (s_panel_rx_data[1]) {
+      switch (link->panel_rx_data[1]) {
       case k_rx_subcmd_other_panelid: 
 		// Panel ID specification ("ppp" is left but not used)
         /*++++++++++++++++++++++++++++++++++++++++++++++
@@ -531,17 +698,20 @@ static void s_rx_msg_handler(uint8_t data)
           3rd    :[0][0000000] MessageID = 0
           4th    :[0][0000PPP] Specify panel ID number
           +++++++++++++++++++++++++++++++++++++++++++++*/
-        if (s_panel_rx_data_cnt >= 3 && s_panel_rx_data[0] == 4) {
-          s_panel_id = ((s_panel_rx_data[2] & 0x07) << 3) & PANEL_ID_MASK;
-          s_dummy_tx_cmd = s_panel_id | 0xC7; // B'11ppp111;
+        if (link->panel_rx_data_cnt >= 3 && link->panel_rx_data[0] == 4) {
+          const uint8_t panel_id = ((link->panel_rx_data[2] & 0x07) << 3) & PANEL_ID_MASK;
+          s_link_rx_valid(link, false);
+          s_link_panel_id_assigned(link, panel_id);
+          link->panel_id = panel_id;
+          link->dummy_tx_cmd = link->panel_id | 0xC7; // B'11ppp111;
           // Send version to HOST 
-          s_tx_cmd_other_version(false);
+          s_tx_cmd_other_version(link, false);
           // Send all SW Pattern to HOST
-          s_tx_cmd_other_bootmode(true);
+          s_tx_cmd_other_bootmode(link, true);
         }
         // Reset rx status
-        s_panel_rx_status = 0;
-        s_panel_rx_data_cnt = 0;
+        link->panel_rx_status = 0;
+        link->panel_rx_data_cnt = 0;
         break;
         
       case k_rx_subcmd_other_stsreq:
@@ -553,10 +723,11 @@ static void s_rx_msg_handler(uint8_t data)
           2nd    :[0][0000011] Size=3
           3rd    :[0][0000001] MessageID = 1
           +++++++++++++++++++++++++++++++++++++++++++++*/
-        s_tx_cmd_other_bootmode(true);
+        s_link_rx_valid(link, false);
+        s_tx_cmd_other_bootmode(link, true);
         // Reset rx status
-        s_panel_rx_status = 0;
-        s_panel_rx_data_cnt = 0;
+        link->panel_rx_status = 0;
+        link->panel_rx_data_cnt = 0;
         break;
         
       case k_rx_subcmd_other_ackreq: // Panel ACK req
@@ -568,115 +739,212 @@ static void s_rx_msg_handler(uint8_t data)
           2nd    :[0][0000011] Size=3
           3rd    :[0][0000011] MessageID = 3
           +++++++++++++++++++++++++++++++++++++++++++++*/
-        s_tx_cmd_other_ack(true);
+        s_link_rx_valid(link, true);
+        s_tx_cmd_other_ack(link, true);
         // Reset rx status
-        s_panel_rx_status = 0;
-        s_panel_rx_data_cnt = 0;
+        link->panel_rx_status = 0;
+        link->panel_rx_data_cnt = 0;
         break;
         
       default:
         // Undefined command - ignore and reset
-        s_panel_rx_status = 0;
-        s_panel_rx_data_cnt = 0;
+        link->panel_rx_status = 0;
+        link->panel_rx_data_cnt = 0;
         break;
       }
     } // end case k_rx_cmd_other:
     break;
   case k_rx_cmd_dummy:
   default:
-    s_panel_rx_status = 0;		// Clear save status/
-    s_panel_rx_data_cnt = 0;   // Initialize data count
+    link->panel_rx_status = 0;		// Clear save status/
+    link->panel_rx_data_cnt = 0;   // Initialize data count
     break;
   }
 }
-
 // ----------------------------------------------------
 
-extern void SPI_IRQ_HANDLER()
+#if NTS1_ISR_STATS
+static void s_isr_stats_record(nts1_link_t *link, uint32_t cycles, uint8_t bytes)
+{
+  if (link->isr_stats.entries == 0 || cycles < link->isr_stats.min_cycles)
+    link->isr_stats.min_cycles = cycles;
+  if (cycles > link->isr_stats.max_cycles)
+    link->isr_stats.max_cycles = cycles;
+  if (bytes > link->isr_stats.max_bytes)
+    link->isr_stats.max_bytes = bytes;
+  if (cycles > (uint32_t)ISR_BUDGET_CYCLES * (bytes ? bytes : 1))
+    link->isr_stats.over_budget++;
+  link->isr_stats.entries++;
+  link->isr_stats.bytes += bytes;
+  link->isr_stats.total_cycles += cycles;
+}
+#endif
+
+// Returns the number of bytes received in this entry
+static uint8_t s_link_service(nts1_link_t *link)
 {  
-  volatile uint16_t sr;
   uint8_t txdata, rxdata;
+  uint8_t rxcount = 0;
   
   // HOST-> PANEL receiver
-  while ((sr = SPI_PERIPH->SR) & SPI_SR_RXNE) {
-    rxdata = s_spi_raw_fifo_pop8(SPI_PERIPH); //  The RXNE flag is cleared by reading DR
-    if (!s_spi_rx_buf_write(rxdata)) {
+  while (nts1_port_rx_ready(&link->port)) {
+    rxdata = nts1_port_rx_pop(&link->port);
+    rxcount++;
+    if (!s_spi_rx_buf_write(link, rxdata)) {
       // Reset when RxBuf is full.
-      SPI_RX_BUF_RESET();
+      SPI_RX_BUF_RESET(link);
+      link->buf_stats.rx_overflows++;
     } 
     else {
-      if (!s_spi_chk_rx_buf_space(32)) {
-         s_port_wait_ack();
+      if (!s_spi_chk_rx_buf_space(link, 32)) {
+         s_port_wait_ack(link);
       } else { // Buffer balance is restored
-         s_port_startup_ack();
+         s_port_startup_ack(link);
       }
     }
    //}
   }
 
   // HOST <- PANEL transmitter 
-  if (!SPI_TX_BUF_EMPTY()) { // 送信Bufferにデータあり
-    txdata = s_spi_tx_buf_read();
+  if (!SPI_TX_BUF_EMPTY(link)) { // 送信Bufferにデータあり
+    txdata = s_spi_tx_buf_read(link);
+    NTS1_TRACE_TX_BYTE(link, link->tx_ridx);
     if (txdata & 0x80) { // Statusの時は、EndMarkを付加するかチェックする。
-      if (!SPI_TX_BUF_EMPTY()) { // 送信Bufferに次に送信するデータあり
+      if (!SPI_TX_BUF_EMPTY(link)) { // 送信Bufferに次に送信するデータあり
         txdata |= PANEL_CMD_EMARK;
         // Note: this will set endmark on almost any status, especially those who have pending data,
         // which seems to contradict the endmark common usage of marking only the last command of a group
       }
     }
-    s_spi_raw_fifo_push8(SPI_PERIPH, txdata);
+    nts1_port_tx_push(&link->port, txdata);
   }
   else { // 送信バッファーが空なのでダミーをセットする。
-    s_spi_raw_fifo_push8(SPI_PERIPH, s_dummy_tx_cmd);
+    nts1_port_tx_push(&link->port, link->dummy_tx_cmd);
   }
+  return rxcount;
+}
+
+void nts1_link_isr(nts1_link_t *link)
+{
+#if NTS1_ISR_STATS
+  const uint32_t start = nts1_port_cycles(&link->port);
+  const uint8_t bytes = s_link_service(link);
+  s_isr_stats_record(link, (nts1_port_cycles(&link->port) - start) & NTS1_PORT_CYCLES_MASK, bytes);
+#else
+  s_link_service(link);
+#endif
 }
 
 // ----------------------------------------------------
-  
-nts1_status_t nts1_init()
+
+void nts1_link_setup(nts1_link_t *link, const nts1_link_handlers_t *handlers, void *ctx)
 {
-  ACK_GPIO_CLK_ENABLE();
-  
-  GPIO_InitTypeDef gpio;
-
-  /* PANEL ACK */
-  gpio.Mode = GPIO_MODE_OUTPUT_PP;
-  gpio.Speed = GPIO_SPEED_FREQ_HIGH;
-  gpio.Pull = GPIO_NOPULL;
-  gpio.Alternate = 0;
-  gpio.Pin = ACK_PIN;
-  HAL_GPIO_Init(ACK_PORT, &gpio);
+  assert(link != NULL && handlers != NULL);
+  memset(link, 0, sizeof(*link));
+  link->panel_id = PANEL_ID_MASK; // Bits 3-5 "ppp"="111"
+  link->dummy_tx_cmd = (PANEL_ID_MASK + 0xC7); // B'11ppp111;
+  link->buf_stats.tx_size = SPI_TX_BUF_SIZE;
+  link->buf_stats.rx_size = SPI_RX_BUF_SIZE;
+  link->handlers = handlers;
+  link->handlers_ctx = ctx;
+  nts1_port_setup(&link->port, link);
+}
   
-  HAL_StatusTypeDef res = s_spi_init();
-  if (res != HAL_OK) 
+nts1_status_t nts1_link_init(nts1_link_t *link)
+{
+  s_link_reset(link);
+
+  const uint8_t res = nts1_port_init(&link->port);
+  if (res != 0) 
     return (nts1_status_t)res;
+#if NTS1_ISR_STATS
+  nts1_port_cycles_init(&link->port);
+#endif
   
   // Fill TX FIFO
-  s_spi_raw_fifo_push8(SPI_PERIPH, s_dummy_tx_cmd);
-  s_spi_raw_fifo_push8(SPI_PERIPH, s_dummy_tx_cmd);
-  s_spi_raw_fifo_push8(SPI_PERIPH, s_dummy_tx_cmd);
-  s_spi_raw_fifo_push8(SPI_PERIPH, s_dummy_tx_cmd);
-  //*/
+  nts1_port_tx_push(&link->port, link->dummy_tx_cmd);
+  nts1_port_tx_push(&link->port, link->dummy_tx_cmd);
+  nts1_port_tx_push(&link->port, link->dummy_tx_cmd);
+  nts1_port_tx_push(&link->port, link->dummy_tx_cmd);
   
-  s_port_startup_ack();
-  s_started = true;
+  s_port_startup_ack(link);
+  link->started = true;
   
   return k_nts1_status_ok;
 }
 
-nts1_status_t nts1_teardown()
+nts1_status_t nts1_link_teardown(nts1_link_t *link)
 {
-  HAL_StatusTypeDef res = s_spi_teardown();
+  link->started = false;
+  return (nts1_status_t)nts1_port_teardown(&link->port);
+}
 
-  return (nts1_status_t)res;
+static uint8_t s_restore_send(nts1_link_t *link, uint8_t slot, uint8_t endmark)
+{
+  nts1_tx_param_change_t param;
+  param.param_id = (slot >= k_num_param_id) ? k_param_id_osc_edit : slot;
+  param.param_subid = (slot >= k_num_param_id) ? slot - k_num_param_id : 0;
+  const uint32_t state = CRITICAL_ENTER(link);
+  const uint16_t value = link->param_desired[slot];
+  param.msb = (value >> 7) & 0x7F;
+  param.lsb = value & 0x7F;
+  const uint8_t queued = s_tx_cmd_param_change(link, &param, endmark);
+  if (queued) {
+    link->param_known[slot] = value;
+    SLOT_SET(link->param_known_valid, slot);
+    s_param_update_dirty(link, slot);
+  }
+  CRITICAL_EXIT(link, state);
+  return queued;
+}
+
+// Send only the dirty slots, audible ones first, as one burst with a
+// single end mark. If the TX ring cannot take the whole burst, send what
+// fits and continue on the next idle pass.
+static void s_link_restore(nts1_link_t *link)
+{
+  uint16_t dirty = 0;
+  for (uint8_t slot = 0; slot < PARAM_SLOTS; ++slot) {
+    if (SLOT_TEST(link->param_dirty, slot))
+      dirty++;
+  }
+  uint16_t budget = dirty;
+  if (dirty > 0) {
+    const uint32_t state = CRITICAL_ENTER(link);
+    const uint16_t space = (SPI_TX_BUF_SIZE - 1 - link->tx_widx + link->tx_ridx) & SPI_TX_BUF_MASK;
+    CRITICAL_EXIT(link, state);
+    if (space / 5 < budget)
+      budget = space / 5;
+    if (budget == 0)
+      return; // TX ring full, continue next time
+  }
+  uint16_t sent = 0;
+  for (uint8_t r = 0; r < sizeof(s_restore_order) / sizeof(s_restore_order[0]) && sent < budget; ++r) {
+    for (uint8_t slot = s_restore_order[r].first; slot <= s_restore_order[r].last && sent < budget; ++slot) {
+      if (!SLOT_TEST(link->param_dirty, slot))
+        continue;
+      if (!s_restore_send(link, slot, (sent + 1 == budget)))
+        return; // raced with another producer, continue next time
+      sent++;
+    }
+  }
+  link->wd.stats.restored_params += sent;
+  if (sent < dirty)
+    return;
+  link->wd.restore_pending = false;
+  link->wd.stats.restores++;
+  const uint32_t us = TIMESTAMP(link) - link->wd.recover_start_us;
+  link->wd.stats.last_recover_us = us;
+  if (us > link->wd.stats.max_recover_us)
+    link->wd.stats.max_recover_us = us;
 }
 
-nts1_status_t nts1_idle()
+nts1_status_t nts1_link_idle(nts1_link_t *link)
 {
   // HOST通信の復帰Check
-  if (s_started) {
-    if (s_spi_chk_rx_buf_space(32)) {
-      s_port_startup_ack();
+  if (link->started) {
+    if (s_spi_chk_rx_buf_space(link, 32)) {
+      s_port_startup_ack(link);
     }
   }
   
@@ -684,33 +952,115 @@ nts1_status_t nts1_idle()
   /* for (uint8_t cnt = 0; cnt < 32; cnt++) { */
   /*   if (SPI_RX_BUF_EMPTY()) */
   /*     break; */
-  while (!SPI_RX_BUF_EMPTY()) {
+  while (!SPI_RX_BUF_EMPTY(link)) {
     // 受信Bufferにデータあり
-    s_rx_msg_handler(s_spi_rx_buf_read());
+    NTS1_TRACE_RX_READ(link, link->rx_ridx);
+    s_rx_msg_handler(link, s_spi_rx_buf_read(link));
+  }
+  s_rx_batch_flush(link);
+
+  if (link->started) {
+    s_link_check_timeout(link);
+    if (link->wd.restore_pending)
+      s_link_restore(link);
   }
   return (nts1_status_t)0;
 }
 
+void nts1_link_get_buf_stats(nts1_link_t *link, nts1_buf_stats_t *stats)
+{
+  assert(stats != NULL);
+  const uint32_t state = CRITICAL_ENTER(link);
+  *stats = link->buf_stats;
+  CRITICAL_EXIT(link, state);
+}
+
+void nts1_link_get_stats(nts1_link_t *link, nts1_link_stats_t *stats)
+{
+  assert(stats != NULL);
+  const uint32_t now = TIMESTAMP(link);
+  *stats = link->wd.stats;
+  stats->state = link->wd.state;
+  stats->panel_id = link->panel_id >> 3;
+  stats->since_rx_us = now - link->wd.last_rx_us;
+  stats->since_ackreq_us = now - link->wd.last_ackreq_us;
+}
+
+#if NTS1_ISR_STATS
+void nts1_link_get_isr_stats(nts1_link_t *link, nts1_isr_stats_t *stats)
+{
+  assert(stats != NULL);
+  const uint32_t state = CRITICAL_ENTER(link);
+  stats->entries = link->isr_stats.entries;
+  stats->bytes = link->isr_stats.bytes;
+  stats->min_cycles = link->isr_stats.min_cycles;
+  stats->max_cycles = link->isr_stats.max_cycles;
+  stats->max_bytes = link->isr_stats.max_bytes;
+  stats->over_budget = link->isr_stats.over_budget;
+  stats->avg_cycles = link->isr_stats.entries ? (uint32_t)(link->isr_stats.total_cycles / link->isr_stats.entries) : 0;
+  CRITICAL_EXIT(link, state);
+  stats->budget_cycles = ISR_BUDGET_CYCLES;
+  stats->core_hz = NTS1_PORT_CORE_HZ;
+}
+
+void nts1_link_reset_isr_stats(nts1_link_t *link)
+{
+  const uint32_t state = CRITICAL_ENTER(link);
+  memset(&link->isr_stats, 0, sizeof(link->isr_stats));
+  CRITICAL_EXIT(link, state);
+}
+#endif
+
+void nts1_link_set_rx_batch_mask(nts1_link_t *link, uint8_t mask)
+{
+  s_rx_batch_flush(link);
+  link->rx_batch_mask = mask;
+}
+
+uint16_t nts1_link_get_tx_free(nts1_link_t *link)
+{
+  const uint32_t state = CRITICAL_ENTER(link);
+  const uint16_t used = (SPI_TX_BUF_SIZE + link->tx_widx - link->tx_ridx) & SPI_TX_BUF_MASK;
+  CRITICAL_EXIT(link, state);
+  return SPI_TX_BUF_SIZE - 1 - used;
+}
+
+void nts1_link_reset_buf_stats(nts1_link_t *link)
+{
+  const uint32_t state = CRITICAL_ENTER(link);
+  link->buf_stats.tx_high_water = 0;
+  link->buf_stats.rx_high_water = 0;
+  link->buf_stats.rx_overflows = 0;
+  link->buf_stats.tx_rejects = 0;
+  CRITICAL_EXIT(link, state);
+}
+
 // ----------------------------------------------------
   
-nts1_status_t nts1_send_events(nts1_tx_event_t *events, uint8_t count)
+nts1_status_t nts1_link_send_events(nts1_link_t *link, nts1_tx_event_t *events, uint8_t count)
 {
   assert(events != NULL);
   for (uint8_t i=0; i < count; ++i) {
-    if (!s_tx_cmd_event(&events[i], (i == count-1))) {
+    if (!s_tx_cmd_event(link, &events[i], (i == count-1))) {
       return k_nts1_status_busy;
     }
   }
   return k_nts1_status_ok;
 }
 
-nts1_status_t nts1_send_param_changes(nts1_tx_param_change_t *param_changes, uint8_t count)
+nts1_status_t nts1_link_send_param_changes(nts1_link_t *link, nts1_tx_param_change_t *param_changes, uint8_t count)
 {
   assert(param_changes != NULL);
   for (uint8_t i=0; i < count; ++i) {
-    if (!s_tx_cmd_param_change(&param_changes[i], (i == count-1))) {
-      return k_nts1_status_busy;
+    s_param_record(link, param_changes[i].param_id, param_changes[i].param_subid,
+                   ((param_changes[i].msb & 0x7F) << 7) | (param_changes[i].lsb & 0x7F));
+  }
+  for (uint8_t i=0; i < count; ++i) {
+    if (!s_tx_cmd_param_change(link, &param_changes[i], (i == count-1))) {
+      return k_nts1_status_busy; // left dirty, picked up by the next restore
     }
+    s_param_known_value(link, param_changes[i].param_id, param_changes[i].param_subid,
+                        ((param_changes[i].msb & 0x7F) << 7) | (param_changes[i].lsb & 0x7F));
   }
   return k_nts1_status_ok;
 }
@@ -765,182 +1115,355 @@ uint32_t nts1_convert_8to7(uint8_t *dest7, const uint8_t *src8, uint32_t size8)
   return size7;
 }
 
-nts1_status_t nts1_param_change(uint8_t id, uint8_t subid, uint16_t value) {
+nts1_status_t nts1_link_param_change(nts1_link_t *link, uint8_t id, uint8_t subid, uint16_t value) {
   nts1_tx_param_change_t param;
   param.param_id = id;
   param.param_subid = subid;
   param.msb = (value >> 7) & 0x7F;
   param.lsb = value & 0x7F;
-  return nts1_send_param_change(&param);
+  return nts1_link_send_param_change(link, &param);
 }
 
-nts1_status_t nts1_note_on(uint8_t note, uint8_t velo) {
+nts1_status_t nts1_link_note_on(nts1_link_t *link, uint8_t note, uint8_t velo) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_note_on;
   event.msb = note & 0x7F;
   event.lsb = velo & 0x7F;
-  return nts1_send_event(&event); 
+  return nts1_link_send_event(link, &event); 
 }
 
-nts1_status_t nts1_note_off(uint8_t note) {
+nts1_status_t nts1_link_note_off(nts1_link_t *link, uint8_t note) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_note_off;
   event.msb = note & 0x7F;
   event.lsb = 0x00;
-  return nts1_send_event(&event);  
+  return nts1_link_send_event(link, &event);  
 }
 
-nts1_status_t nts1_req_sys_version(void) {
+nts1_status_t nts1_link_req_sys_version(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_value;
   event.msb = k_param_id_sys_version;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_param_value(uint8_t id, uint8_t subid) {
+nts1_status_t nts1_link_req_param_value(nts1_link_t *link, uint8_t id, uint8_t subid) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_value;
   event.msb = id;
   event.lsb = subid;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_osc_count(void) {
+nts1_status_t nts1_link_req_osc_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_osc_type;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_osc_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_osc_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_osc_type;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_osc_edit_param_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_osc_edit_param_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_edit_param_desc;
   event.msb = k_param_id_osc_type;
   event.lsb = idx;
-  return nts1_send_event(&event);  
+  return nts1_link_send_event(link, &event);  
 }
 
-nts1_status_t nts1_req_filt_count(void) {
+nts1_status_t nts1_link_req_filt_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_filt_type;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_filt_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_filt_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_filt_type;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_ampeg_count(void) {
+nts1_status_t nts1_link_req_ampeg_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_ampeg_type;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_ampeg_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_ampeg_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_ampeg_type;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_mod_count(void) {
+nts1_status_t nts1_link_req_mod_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_mod_type;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_mod_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_mod_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_mod_type;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_del_count(void) {
+nts1_status_t nts1_link_req_del_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_del_type;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_del_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_del_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_del_type;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_rev_count(void) {
+nts1_status_t nts1_link_req_rev_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_rev_type;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_rev_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_rev_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_rev_type;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_arp_pattern_count(void) {
+nts1_status_t nts1_link_req_arp_pattern_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_arp_pattern;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_arp_pattern_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_arp_pattern_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_arp_pattern;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
 }
 
-nts1_status_t nts1_req_arp_intervals_count(void) {
+nts1_status_t nts1_link_req_arp_intervals_count(nts1_link_t *link) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_count;
   event.msb = k_param_id_arp_intervals;
   event.lsb = 0x0;
-  return nts1_send_event(&event);
+  return nts1_link_send_event(link, &event);
 }
 
-nts1_status_t nts1_req_arp_intervals_desc(uint8_t idx) {
+nts1_status_t nts1_link_req_arp_intervals_desc(nts1_link_t *link, uint8_t idx) {
   nts1_tx_event_t event;
   event.event_id = k_nts1_tx_event_id_req_unit_desc;
   event.msb = k_param_id_arp_intervals;
   event.lsb = idx & 0x7F;
-  return nts1_send_event(&event);    
+  return nts1_link_send_event(link, &event);    
+}
+
+// ----------------------------------------------------
+// Default link, behind the nts1_* API
+
+static void s_default_note_off(void *ctx, const nts1_rx_note_off_t *note_off)
+{
+  nts1_handle_note_off_event(note_off);
+}
+
+static void s_default_note_on(void *ctx, const nts1_rx_note_on_t *note_on)
+{
+  nts1_handle_note_on_event(note_on);
+}
+
+static void s_default_step_tick(void *ctx)
+{
+  nts1_handle_step_tick_event();
+}
+
+static void s_default_unit_desc(void *ctx, const nts1_rx_unit_desc_t *unit_desc)
+{
+  nts1_handle_unit_desc_event(unit_desc);
+}
+
+static void s_default_edit_param_desc(void *ctx, const nts1_rx_edit_param_desc_t *param_desc)
+{
+  nts1_handle_edit_param_desc_event(param_desc);
+}
+
+static void s_default_value(void *ctx, const nts1_rx_value_t *value)
+{
+  nts1_handle_value_event(value);
+}
+
+static void s_default_param_change(void *ctx, const nts1_rx_param_change_t *param_change)
+{
+  nts1_handle_param_change(param_change);
+}
+
+static void s_default_link_event(void *ctx, nts1_link_event_t event)
+{
+  nts1_handle_link_event(event);
+}
+
+static void s_default_note_off_batch(void *ctx, const nts1_rx_note_off_t *note_offs, uint8_t count)
+{
+  nts1_handle_note_off_batch(note_offs, count);
+}
+
+static void s_default_note_on_batch(void *ctx, const nts1_rx_note_on_t *note_ons, uint8_t count)
+{
+  nts1_handle_note_on_batch(note_ons, count);
+}
+
+static void s_default_value_batch(void *ctx, const nts1_rx_value_t *values, uint8_t count)
+{
+  nts1_handle_value_batch(values, count);
+}
+
+static void s_default_param_change_batch(void *ctx, const nts1_rx_param_change_t *param_changes, uint8_t count)
+{
+  nts1_handle_param_change_batch(param_changes, count);
+}
+
+static const nts1_link_handlers_t s_default_handlers = {
+  s_default_note_off,
+  s_default_note_on,
+  s_default_step_tick,
+  s_default_unit_desc,
+  s_default_edit_param_desc,
+  s_default_value,
+  s_default_param_change,
+  s_default_link_event,
+  s_default_note_off_batch,
+  s_default_note_on_batch,
+  s_default_value_batch,
+  s_default_param_change_batch,
+};
+
+static nts1_link_t s_default_link;
+static uint8_t     s_default_link_ready;
+
+// Set up on first use, so the nts1_* API works before nts1_init() as it
+// always did. Not thread safe: call nts1_init() before sharing the link.
+static nts1_link_t *s_default(void)
+{
+  if (!s_default_link_ready) {
+    nts1_link_setup(&s_default_link, &s_default_handlers, NULL);
+    s_default_link_ready = true;
+  }
+  return &s_default_link;
+}
+
+__attribute__((weak)) void nts1_handle_note_off_event(const nts1_rx_note_off_t *note_off) {}
+__attribute__((weak)) void nts1_handle_note_on_event(const nts1_rx_note_on_t *note_on) {}
+__attribute__((weak)) void nts1_handle_step_tick_event(void) {}
+__attribute__((weak)) void nts1_handle_unit_desc_event(const nts1_rx_unit_desc_t *unit_desc) {}
+__attribute__((weak)) void nts1_handle_edit_param_desc_event(const nts1_rx_edit_param_desc_t *param_desc) {}
+__attribute__((weak)) void nts1_handle_value_event(const nts1_rx_value_t *value) {}
+__attribute__((weak)) void nts1_handle_param_change(const nts1_rx_param_change_t *param_change) {}
+__attribute__((weak)) void nts1_handle_link_event(nts1_link_event_t event) {}
+
+__attribute__((weak))
+void nts1_handle_note_off_batch(const nts1_rx_note_off_t *note_offs, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+    nts1_handle_note_off_event(&note_offs[i]);
+}
+
+__attribute__((weak))
+void nts1_handle_note_on_batch(const nts1_rx_note_on_t *note_ons, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+    nts1_handle_note_on_event(&note_ons[i]);
+}
+
+__attribute__((weak))
+void nts1_handle_value_batch(const nts1_rx_value_t *values, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+    nts1_handle_value_event(&values[i]);
+}
+
+__attribute__((weak))
+void nts1_handle_param_change_batch(const nts1_rx_param_change_t *param_changes, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+    nts1_handle_param_change(&param_changes[i]);
+}
+
+nts1_status_t nts1_init() { return nts1_link_init(s_default()); }
+nts1_status_t nts1_teardown() { return nts1_link_teardown(s_default()); }
+nts1_status_t nts1_idle() { return nts1_link_idle(s_default()); }
+
+void nts1_get_buf_stats(nts1_buf_stats_t *stats) { nts1_link_get_buf_stats(s_default(), stats); }
+void nts1_reset_buf_stats(void) { nts1_link_reset_buf_stats(s_default()); }
+void nts1_get_link_stats(nts1_link_stats_t *stats) { nts1_link_get_stats(s_default(), stats); }
+uint16_t nts1_get_tx_free(void) { return nts1_link_get_tx_free(s_default()); }
+#if NTS1_ISR_STATS
+void nts1_get_isr_stats(nts1_isr_stats_t *stats) { nts1_link_get_isr_stats(s_default(), stats); }
+void nts1_reset_isr_stats(void) { nts1_link_reset_isr_stats(s_default()); }
+#endif
+void nts1_set_rx_batch_mask(uint8_t mask) { nts1_link_set_rx_batch_mask(s_default(), mask); }
+
+nts1_status_t nts1_send_events(nts1_tx_event_t *events, uint8_t count) {
+  return nts1_link_send_events(s_default(), events, count);
+}
+
+nts1_status_t nts1_send_param_changes(nts1_tx_param_change_t *param_changes, uint8_t count) {
+  return nts1_link_send_param_changes(s_default(), param_changes, count);
 }
 
+nts1_status_t nts1_param_change(uint8_t id, uint8_t subid, uint16_t value) { return nts1_link_param_change(s_default(), id, subid, value); }
+nts1_status_t nts1_note_on(uint8_t note, uint8_t velo) { return nts1_link_note_on(s_default(), note, velo); }
+nts1_status_t nts1_note_off(uint8_t note) { return nts1_link_note_off(s_default(), note); }
+nts1_status_t nts1_req_sys_version(void) { return nts1_link_req_sys_version(s_default()); }
+nts1_status_t nts1_req_param_value(uint8_t id, uint8_t subid) { return nts1_link_req_param_value(s_default(), id, subid); }
+nts1_status_t nts1_req_osc_count(void) { return nts1_link_req_osc_count(s_default()); }
+nts1_status_t nts1_req_osc_desc(uint8_t idx) { return nts1_link_req_osc_desc(s_default(), idx); }
+nts1_status_t nts1_req_osc_edit_param_desc(uint8_t idx) { return nts1_link_req_osc_edit_param_desc(s_default(), idx); }
+nts1_status_t nts1_req_filt_count(void) { return nts1_link_req_filt_count(s_default()); }
+nts1_status_t nts1_req_filt_desc(uint8_t idx) { return nts1_link_req_filt_desc(s_default(), idx); }
+nts1_status_t nts1_req_ampeg_count(void) { return nts1_link_req_ampeg_count(s_default()); }
+nts1_status_t nts1_req_ampeg_desc(uint8_t idx) { return nts1_link_req_ampeg_desc(s_default(), idx); }
+nts1_status_t nts1_req_mod_count(void) { return nts1_link_req_mod_count(s_default()); }
+nts1_status_t nts1_req_mod_desc(uint8_t idx) { return nts1_link_req_mod_desc(s_default(), idx); }
+nts1_status_t nts1_req_del_count(void) { return nts1_link_req_del_count(s_default()); }
+nts1_status_t nts1_req_del_desc(uint8_t idx) { return nts1_link_req_del_desc(s_default(), idx); }
+nts1_status_t nts1_req_rev_count(void) { return nts1_link_req_rev_count(s_default()); }
+nts1_status_t nts1_req_rev_desc(uint8_t idx) { return nts1_link_req_rev_desc(s_default(), idx); }
+nts1_status_t nts1_req_arp_pattern_count(void) { return nts1_link_req_arp_pattern_count(s_default()); }
+nts1_status_t nts1_req_arp_pattern_desc(uint8_t idx) { return nts1_link_req_arp_pattern_desc(s_default(), idx); }
+nts1_status_t nts1_req_arp_intervals_count(void) { return nts1_link_req_arp_intervals_count(s_default()); }
+nts1_status_t nts1_req_arp_intervals_desc(uint8_t idx) { return nts1_link_req_arp_intervals_desc(s_default(), idx); }
 
 // ----------------------------------------------------
@@ -37,6 +37,15 @@
 
 #include <stdint.h>
 
+// Link ISR cycle measurement, nts1-isr-stats config option
+#if !defined(NTS1_ISR_STATS)
+#if defined(MBED_CONF_APP_NTS1_ISR_STATS)
+#define NTS1_ISR_STATS MBED_CONF_APP_NTS1_ISR_STATS
+#else
+#define NTS1_ISR_STATS 0
+#endif
+#endif
+
 enum {
   k_nts1_status_ok      = 0x00U,
   k_nts1_status_error   = 0x01U,
@@ -274,6 +283,64 @@ typedef struct {
   char     name[13];
 } nts1_rx_edit_param_desc_t;
 
+typedef struct nts1_buf_stats {
+  uint16_t tx_size;       // configured TX ring size
+  uint16_t tx_high_water; // most bytes ever queued for transmission
+  uint16_t rx_size;       // configured RX ring size
+  uint16_t rx_high_water; // most bytes ever waiting for nts1_idle()
+  uint32_t rx_overflows;  // RX ring resets because it was full
+  uint32_t tx_rejects;    // frames refused because the TX ring was full
+} nts1_buf_stats_t;
+
+enum {
+  k_nts1_link_state_down = 0U, // nothing received since nts1_init()
+  k_nts1_link_state_up,
+  k_nts1_link_state_lost,      // no valid frame within the link timeout
+};
+
+enum {
+  k_nts1_link_event_up       = 0x0U, // first valid frame after nts1_init()
+  k_nts1_link_event_lost     = 0x1U, // link timed out, TX ring flushed
+  k_nts1_link_event_restored = 0x2U, // frames received again after a loss
+  k_nts1_link_event_panel_id = 0x3U, // main board reassigned the panel ID
+};
+
+typedef uint8_t nts1_link_event_t;
+
+// Event types that can be delivered in batches, see nts1_set_rx_batch_mask()
+enum {
+  k_nts1_rx_batch_note_off     = 1U << 0,
+  k_nts1_rx_batch_note_on      = 1U << 1,
+  k_nts1_rx_batch_value        = 1U << 2,
+  k_nts1_rx_batch_param_change = 1U << 3,
+};
+
+typedef struct nts1_isr_stats {
+  uint32_t entries;        // link ISR invocations measured
+  uint32_t bytes;          // bytes received over all entries
+  uint32_t min_cycles;     // per entry
+  uint32_t avg_cycles;
+  uint32_t max_cycles;
+  uint32_t max_bytes;      // most bytes drained in one entry
+  uint32_t budget_cycles;  // per byte, from link byte rate and ISR load limit
+  uint32_t over_budget;    // entries slower than budget_cycles * bytes
+  uint32_t core_hz;        // cycle counter rate
+} nts1_isr_stats_t;
+
+typedef struct nts1_link_stats {
+  uint8_t  state;            // k_nts1_link_state_*
+  uint8_t  panel_id;         // 0..7
+  uint16_t lost_count;       // link timeouts
+  uint16_t panel_id_changes; // panel ID reassignments
+  uint16_t restores;         // completed state restore bursts
+  uint16_t restored_params;  // changed params re-sent by the last restore
+  uint32_t flushed_bytes;    // stale TX bytes dropped on loss/reassignment
+  uint32_t since_rx_us;      // time since the last valid frame
+  uint32_t since_ackreq_us;  // time since the last ACK request
+  uint32_t last_recover_us;  // link back (or ID change) to state restored
+  uint32_t max_recover_us;
+} nts1_link_stats_t;
+
 typedef void (*nts1_note_off_event_handler)(const nts1_rx_note_off_t *);
 typedef void (*nts1_note_on_event_handler)(const nts1_rx_note_on_t *);
 typedef void (*nts1_step_tick_event_handler)(void);
@@ -281,15 +348,61 @@ typedef void (*nts1_unit_desc_event_handler)(const nts1_rx_unit_desc_t *);
 typedef void (*nts1_edit_param_desc_event_handler)(const nts1_rx_edit_param_desc_t *);
 typedef void (*nts1_value_event_handler)(const nts1_rx_value_t *);
 typedef void (*nts1_param_change_handler)(const nts1_rx_param_change_t *);
+typedef void (*nts1_link_event_handler)(nts1_link_event_t);
+
+// Transport state of one main board link, see nts1_link.h
+typedef struct nts1_link nts1_link_t;
+
+// Receive callbacks of one link, called from nts1_link_idle() with the
+// context given to nts1_link_setup(). NULL entries are skipped; a NULL
+// batch handler hands the batch to the single event handler one by one.
+typedef struct nts1_link_handlers {
+  void (*note_off)(void *ctx, const nts1_rx_note_off_t *note_off);
+  void (*note_on)(void *ctx, const nts1_rx_note_on_t *note_on);
+  void (*step_tick)(void *ctx);
+  void (*unit_desc)(void *ctx, const nts1_rx_unit_desc_t *unit_desc);
+  void (*edit_param_desc)(void *ctx, const nts1_rx_edit_param_desc_t *param_desc);
+  void (*value)(void *ctx, const nts1_rx_value_t *value);
+  void (*param_change)(void *ctx, const nts1_rx_param_change_t *param_change);
+  void (*link_event)(void *ctx, nts1_link_event_t event);
+  void (*note_off_batch)(void *ctx, const nts1_rx_note_off_t *note_offs, uint8_t count);
+  void (*note_on_batch)(void *ctx, const nts1_rx_note_on_t *note_ons, uint8_t count);
+  void (*value_batch)(void *ctx, const nts1_rx_value_t *values, uint8_t count);
+  void (*param_change_batch)(void *ctx, const nts1_rx_param_change_t *param_changes, uint8_t count);
+} nts1_link_handlers_t;
 
 #ifdef __cplusplus
 extern "C" {
 #endif  
+
+  // The nts1_* functions below drive a default link instance and report
+  // to the nts1_handle_* handlers. Each has an nts1_link_* counterpart
+  // taking an explicit link, for programs with more than one link
+  // (simulated panels on the host). Links share no state, different links
+  // may be used from different threads at the same time.
   
   nts1_status_t nts1_init();
   nts1_status_t nts1_teardown();
   nts1_status_t nts1_idle();
   
+  void nts1_get_buf_stats(nts1_buf_stats_t *stats);
+  void nts1_reset_buf_stats(void);
+  void nts1_get_link_stats(nts1_link_stats_t *stats);
+  uint16_t nts1_get_tx_free(void); // bytes that can be queued right now
+#if NTS1_ISR_STATS
+  void nts1_get_isr_stats(nts1_isr_stats_t *stats);
+  void nts1_reset_isr_stats(void);
+#endif
+
+  // Event types in the mask are collected during nts1_idle() and handed to
+  // the nts1_handle_*_batch() handlers in runs of the same type. A run is
+  // delivered when a different event arrives, the batch is full, or at the
+  // end of the idle pass, so ordering between event types is kept.
+  void nts1_set_rx_batch_mask(uint8_t mask);
+
+  // Each frame is queued whole inside a short critical section, so the
+  // send functions below may be called from the main loop and from
+  // interrupt handlers at the same time.
   nts1_status_t nts1_send_events(nts1_tx_event_t *events, uint8_t count);
 
   static inline nts1_status_t nts1_send_event(nts1_tx_event_t *event) {
@@ -346,8 +459,79 @@ extern "C" {
 
   nts1_status_t nts1_req_arp_intervals_count(void);
   nts1_status_t nts1_req_arp_intervals_desc(uint8_t idx);
+
+  // ----------------------------------------------------
+  
+  /**
+   * Prepare a link: clear all state, bind its port and receive callbacks.
+   * Called once before any other nts1_link_* function on that link.
+   */
+  void nts1_link_setup(nts1_link_t *link, const nts1_link_handlers_t *handlers, void *ctx);
+
+  nts1_status_t nts1_link_init(nts1_link_t *link);
+  nts1_status_t nts1_link_teardown(nts1_link_t *link);
+  nts1_status_t nts1_link_idle(nts1_link_t *link);
+
+  void nts1_link_get_buf_stats(nts1_link_t *link, nts1_buf_stats_t *stats);
+  void nts1_link_reset_buf_stats(nts1_link_t *link);
+  void nts1_link_get_stats(nts1_link_t *link, nts1_link_stats_t *stats);
+  uint16_t nts1_link_get_tx_free(nts1_link_t *link);
+#if NTS1_ISR_STATS
+  void nts1_link_get_isr_stats(nts1_link_t *link, nts1_isr_stats_t *stats);
+  void nts1_link_reset_isr_stats(nts1_link_t *link);
+#endif
+  void nts1_link_set_rx_batch_mask(nts1_link_t *link, uint8_t mask);
+
+  nts1_status_t nts1_link_send_events(nts1_link_t *link, nts1_tx_event_t *events, uint8_t count);
+
+  static inline nts1_status_t nts1_link_send_event(nts1_link_t *link, nts1_tx_event_t *event) {
+    return nts1_link_send_events(link, event, 1);
+  }
+
+  nts1_status_t nts1_link_send_param_changes(nts1_link_t *link, nts1_tx_param_change_t *param_changes, uint8_t count);
+
+  static inline nts1_status_t nts1_link_send_param_change(nts1_link_t *link, nts1_tx_param_change_t *param_change) {
+    return nts1_link_send_param_changes(link, param_change, 1);
+  }
+
+  nts1_status_t nts1_link_param_change(nts1_link_t *link, uint8_t id, uint8_t subid, uint16_t value);
+
+  nts1_status_t nts1_link_note_on(nts1_link_t *link, uint8_t note, uint8_t velo);
+  nts1_status_t nts1_link_note_off(nts1_link_t *link, uint8_t note);
+
+  nts1_status_t nts1_link_req_sys_version(nts1_link_t *link);
+
+  nts1_status_t nts1_link_req_param_value(nts1_link_t *link, uint8_t id, uint8_t subid);
+
+  nts1_status_t nts1_link_req_osc_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_osc_desc(nts1_link_t *link, uint8_t idx);
+  nts1_status_t nts1_link_req_osc_edit_param_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_filt_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_filt_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_ampeg_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_ampeg_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_mod_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_mod_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_del_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_del_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_rev_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_rev_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_arp_pattern_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_arp_pattern_desc(nts1_link_t *link, uint8_t idx);
+
+  nts1_status_t nts1_link_req_arp_intervals_count(nts1_link_t *link);
+  nts1_status_t nts1_link_req_arp_intervals_desc(nts1_link_t *link, uint8_t idx);
+
+  // ----------------------------------------------------
   
-  // RX Event handlers, weakly defined in C++ NTS1 object. 
+  // RX Event handlers of the default link, weakly defined as no-ops (the
+  // batch ones forward to the single event handlers).
   void nts1_handle_note_off_event(const nts1_rx_note_off_t *note_off);
   void nts1_handle_note_on_event(const nts1_rx_note_on_t *note_on);
   void nts1_handle_step_tick_event(void);
@@ -355,6 +539,11 @@ extern "C" {
   void nts1_handle_edit_param_desc_event(const nts1_rx_edit_param_desc_t *param_desc);
   void nts1_handle_value_event(const nts1_rx_value_t *value);
   void nts1_handle_param_change(const nts1_rx_param_change_t *param_change);
+  void nts1_handle_link_event(nts1_link_event_t event);
+  void nts1_handle_note_off_batch(const nts1_rx_note_off_t *note_offs, uint8_t count);
+  void nts1_handle_note_on_batch(const nts1_rx_note_on_t *note_ons, uint8_t count);
+  void nts1_handle_value_batch(const nts1_rx_value_t *values, uint8_t count);
+  void nts1_handle_param_change_batch(const nts1_rx_param_change_t *param_changes, uint8_t count);
   
 #ifdef __cplusplus
 }
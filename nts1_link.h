@@ -0,0 +1,137 @@
+/** @file nts1_link.h
+ * @brief Transport state of one NTS-1 link.
+ *
+ * Everything the protocol layer keeps between calls: rings, receive
+ * parser, link watchdog, parameter restore bookkeeping, batching and the
+ * optional instrumentation. One nts1_link_t per main board connection; the
+ * nts1_* functions in nts1_iface.h work on a default instance, the
+ * nts1_link_* ones on the instance given. Fields are private to
+ * nts1_iface.c, the struct is public only so links can be embedded
+ * (NTS1 objects, simulations) without dynamic allocation.
+ *
+ * @license: BSD 3-Clause License
+ */
+
+#ifndef __nts1_link_h
+#define __nts1_link_h
+
+#include <stdint.h>
+
+#include "nts1_iface.h"
+#include "nts1_port.h"
+#include "nts1_trace.h"
+
+// Ring sizes come from mbed_app.json (nts1-spi-tx-buf-size, nts1-spi-rx-buf-size)
+#ifdef MBED_CONF_APP_NTS1_SPI_TX_BUF_SIZE
+#define NTS1_LINK_TX_BUF_SIZE (MBED_CONF_APP_NTS1_SPI_TX_BUF_SIZE)
+#else
+#define NTS1_LINK_TX_BUF_SIZE (0x200)
+#endif
+
+#ifdef MBED_CONF_APP_NTS1_SPI_RX_BUF_SIZE
+#define NTS1_LINK_RX_BUF_SIZE (MBED_CONF_APP_NTS1_SPI_RX_BUF_SIZE)
+#else
+#define NTS1_LINK_RX_BUF_SIZE (0x200)
+#endif
+
+// Indices are 16 bit, the RX ring needs room above the 32 byte ACK threshold
+#if (NTS1_LINK_TX_BUF_SIZE & (NTS1_LINK_TX_BUF_SIZE - 1)) != 0 || NTS1_LINK_TX_BUF_SIZE < 0x10 || NTS1_LINK_TX_BUF_SIZE > 0x8000
+#error "nts1-spi-tx-buf-size must be a power of two between 0x10 and 0x8000"
+#endif
+#if (NTS1_LINK_RX_BUF_SIZE & (NTS1_LINK_RX_BUF_SIZE - 1)) != 0 || NTS1_LINK_RX_BUF_SIZE < 0x40 || NTS1_LINK_RX_BUF_SIZE > 0x8000
+#error "nts1-spi-rx-buf-size must be a power of two between 0x40 and 0x8000"
+#endif
+
+// Events held for batched delivery
+#ifdef MBED_CONF_APP_NTS1_RX_BATCH_SIZE
+#define NTS1_LINK_RX_BATCH_SIZE MBED_CONF_APP_NTS1_RX_BATCH_SIZE
+#else
+#define NTS1_LINK_RX_BATCH_SIZE 8
+#endif
+#if NTS1_LINK_RX_BATCH_SIZE < 1 || NTS1_LINK_RX_BATCH_SIZE > 255
+#error "nts1-rx-batch-size must be between 1 and 255"
+#endif
+
+// Parameters remembered for restore: all regular IDs plus osc edit sub IDs
+#define NTS1_LINK_PARAM_SLOTS (k_num_param_id + k_num_osc_param_subid)
+#define NTS1_LINK_PARAM_SLOT_WORDS ((NTS1_LINK_PARAM_SLOTS + 31) / 32)
+
+#define NTS1_LINK_RX_DECODE_SIZE 64
+
+// Fields the link ISR touches come first: Cortex-M0 loads reach only 32
+// (bytes) to 124 (words) bytes past the base register.
+struct nts1_link {
+  nts1_port_t port;
+
+  uint16_t tx_ridx;  // Read  Index (from tx_buf)
+  uint16_t tx_widx;  // Write Index (to tx_buf)
+  uint16_t rx_ridx;  // Read  Index (from rx_buf)
+  uint16_t rx_widx;  // Write Index (to rx_buf)
+
+  uint8_t  panel_id;      // Bits 3-5 "ppp"
+  uint8_t  dummy_tx_cmd;  // B'11ppp111
+  uint8_t  started;
+  uint8_t  panel_rx_status;
+  uint8_t  panel_rx_data_cnt;
+
+  // Batched RX delivery
+  uint8_t  rx_batch_mask;
+  uint8_t  rx_batch_type;  // k_nts1_rx_batch_* held in rx_batch
+  uint8_t  rx_batch_count;
+
+  // Buffer usage, kept for the whole session (not cleared by nts1_link_init)
+  nts1_buf_stats_t buf_stats;
+
+  // Link watchdog
+  struct {
+    uint8_t  state;
+    uint8_t  panel_id_assigned;
+    uint8_t  restore_pending;
+    uint32_t last_rx_us;
+    uint32_t last_ackreq_us;
+    uint32_t recover_start_us;
+    nts1_link_stats_t stats;
+  } wd;
+
+  const nts1_link_handlers_t *handlers;
+  void *handlers_ctx;
+
+#if NTS1_ISR_STATS
+  struct {
+    uint32_t entries;
+    uint32_t bytes;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t max_bytes;
+    uint32_t over_budget;
+    uint64_t total_cycles;
+  } isr_stats;
+#endif
+
+  // Last value the panel asked for and last value the main board is known
+  // to hold, per parameter slot. A slot is dirty while the two differ.
+  uint16_t param_desired[NTS1_LINK_PARAM_SLOTS];
+  uint16_t param_known[NTS1_LINK_PARAM_SLOTS];
+  uint32_t param_desired_valid[NTS1_LINK_PARAM_SLOT_WORDS];
+  uint32_t param_known_valid[NTS1_LINK_PARAM_SLOT_WORDS];
+  uint32_t param_dirty[NTS1_LINK_PARAM_SLOT_WORDS];
+
+  union {
+    nts1_rx_note_off_t     note_off[NTS1_LINK_RX_BATCH_SIZE];
+    nts1_rx_note_on_t      note_on[NTS1_LINK_RX_BATCH_SIZE];
+    nts1_rx_value_t        value[NTS1_LINK_RX_BATCH_SIZE];
+    nts1_rx_param_change_t param_change[NTS1_LINK_RX_BATCH_SIZE];
+  } rx_batch;
+
+  uint8_t  rx_event_decode_buf[NTS1_LINK_RX_DECODE_SIZE] __attribute__((aligned));
+  uint8_t  panel_rx_data[127];
+
+  uint8_t  tx_buf[NTS1_LINK_TX_BUF_SIZE];
+  uint8_t  rx_buf[NTS1_LINK_RX_BUF_SIZE];
+
+#if NTS1_TRACE_LATENCY
+  nts1_trace_t trace;
+#endif
+};
+
+#endif // __nts1_link_h
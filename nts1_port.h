@@ -0,0 +1,103 @@
+/** @file nts1_port.h
+ * @brief Transport port interface used by the NTS-1 protocol layer.
+ *
+ * The protocol code in nts1_iface.c only talks to the link through the
+ * functions below: a byte FIFO towards the main board, the ACK line,
+ * interrupt control, a critical section and a free running timestamp.
+ * Each target provides them in its own nts1_port_<target>.h/.c pair, hot
+ * path functions as static inlines where the hardware allows it.
+ *
+ * @license: BSD 3-Clause License
+ */
+
+#ifndef __nts1_port_h
+#define __nts1_port_h
+
+#include <stdint.h>
+
+struct nts1_link;
+
+/*
+ * Port specific part, each provides the per link port state
+ *   nts1_port_t                 struct nts1_port, first member is
+ *                               struct nts1_link *link
+ * the functions
+ *   uint8_t  nts1_port_rx_ready(nts1_port_t *port)          byte available in RX FIFO
+ *   uint8_t  nts1_port_rx_pop(nts1_port_t *port)            read one byte from RX FIFO
+ *   void     nts1_port_tx_push(nts1_port_t *port, uint8_t)  write one byte to TX FIFO
+ *   void     nts1_port_ack_set(nts1_port_t *port, uint8_t)  drive ACK line, 0 = wait
+ *   void     nts1_port_irq_enable(nts1_port_t *port, uint8_t) enable/disable link IRQ
+ *   uint32_t nts1_port_critical_enter(nts1_port_t *port)    mask interrupts, return state
+ *   void     nts1_port_critical_exit(nts1_port_t *port, uint32_t) restore state
+ *   uint32_t nts1_port_cycles(nts1_port_t *port)            free running core cycle count
+ * and the constants
+ *   NTS1_PORT_CORE_HZ           core clock assumed for the ISR budget
+ *   NTS1_PORT_CYCLES_MASK       width of nts1_port_cycles(), differences
+ *                               are taken modulo this
+ *   NTS1_PORT_ISR_WORST_CYCLES  worst link ISR path per received byte,
+ *                               optional, checked against the byte rate
+ *
+ * MCU ports drive the one SPI peripheral and ignore most of the port
+ * argument; the host port keeps FIFOs, ACK line, clock and lock per link so
+ * simulated panels are independent.
+ */
+#if defined(TARGET_STM32F0)
+#include "nts1_port_stm32f0.h"
+#elif defined(TARGET_STM32F4)
+#include "nts1_port_stm32f4.h"
+#elif !defined(TARGET_LIKE_MBED)
+#include "nts1_port_host.h"
+#else
+#error "nts1_port: no transport port for this target"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /**
+   * Bind the port state to its link and prepare it, no hardware access.
+   * Called once per link before anything else.
+   */
+  void nts1_port_setup(nts1_port_t *port, struct nts1_link *link);
+
+  /**
+   * Bring up the link: SPI slave, pins, ACK output and link interrupt.
+   * Returns 0 on success, 2 (busy) when the peripheral is already owned
+   * by another link's port; ports with a single SPI interrupt serve one
+   * link at a time.
+   */
+  uint8_t nts1_port_init(nts1_port_t *port);
+
+  /**
+   * Shut down the link peripheral and release it for another link.
+   * Does nothing for a port that does not own the peripheral.
+   */
+  uint8_t nts1_port_teardown(nts1_port_t *port);
+
+  /**
+   * Free running timestamp in microseconds, counting through all 32 bits
+   * (wraps after about 71 minutes) whatever the width of the hardware
+   * timer, so uint32 differences of up to that long are valid
+   */
+  uint32_t nts1_port_timestamp(nts1_port_t *port);
+
+  /**
+   * Link service routine, implemented by the protocol layer.
+   * Called by the port from the link interrupt (or the host simulation)
+   * once per transferred byte slot: drains received bytes and pushes the
+   * next byte to send.
+   */
+  void nts1_link_isr(struct nts1_link *link);
+
+  /**
+   * Start the cycle counter behind nts1_port_cycles(), used by the ISR
+   * instrumentation (NTS1_ISR_STATS)
+   */
+  void nts1_port_cycles_init(nts1_port_t *port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __nts1_port_h
@@ -0,0 +1,158 @@
+/** @file nts1_port_host.c
+ * @brief NTS-1 transport port for host builds (Linux, macOS).
+ *
+ * The SPI FIFOs are small rings, the ACK line and interrupt enable are
+ * plain flags, all kept in the port so every link is independent. The
+ * critical section is the port's recursive mutex, also held while the link
+ * service routine runs, so a transfer driven from another thread behaves
+ * like an interrupt with respect to that link's main loop.
+ *
+ * @license: BSD 3-Clause License
+ */
+#if !defined(TARGET_LIKE_MBED)
+
+#include "nts1_port.h"
+
+#include <string.h>
+#include <time.h>
+
+#define FIFO_MASK (NTS1_PORT_HOST_FIFO_SIZE - 1)
+
+// ----------------------------------------------------
+
+static inline uint8_t s_fifo_count(const nts1_port_host_fifo_t *fifo)
+{
+  return (uint8_t)(fifo->widx - fifo->ridx);
+}
+
+static inline uint8_t s_fifo_push(nts1_port_host_fifo_t *fifo, uint8_t data)
+{
+  if (s_fifo_count(fifo) >= NTS1_PORT_HOST_FIFO_SIZE)
+    return 0; // overrun, byte lost as on the real FIFO
+  fifo->buf[fifo->widx++ & FIFO_MASK] = data;
+  return 1;
+}
+
+static inline uint8_t s_fifo_pop(nts1_port_host_fifo_t *fifo)
+{
+  return fifo->buf[fifo->ridx++ & FIFO_MASK];
+}
+
+// ----------------------------------------------------
+
+void nts1_port_setup(nts1_port_t *port, struct nts1_link *link)
+{
+  memset(port, 0, sizeof(*port));
+  port->link = link;
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&port->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+uint8_t nts1_port_init(nts1_port_t *port)
+{
+  port->rx_fifo.ridx = port->rx_fifo.widx = 0;
+  port->tx_fifo.ridx = port->tx_fifo.widx = 0;
+  port->ack = 0;
+  port->irq_enabled = 1;
+  return 0;
+}
+
+uint8_t nts1_port_teardown(nts1_port_t *port)
+{
+  port->irq_enabled = 0;
+  return 0;
+}
+
+uint32_t nts1_port_timestamp(nts1_port_t *port)
+{
+  if (port->sim_clock)
+    return port->sim_time_us;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000);
+}
+
+void nts1_port_cycles_init(nts1_port_t *port)
+{
+  (void)port;
+}
+
+uint32_t nts1_port_cycles(nts1_port_t *port)
+{
+  (void)port;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + ts.tv_nsec);
+}
+
+uint8_t nts1_port_rx_ready(nts1_port_t *port)
+{
+  return s_fifo_count(&port->rx_fifo) != 0;
+}
+
+uint8_t nts1_port_rx_pop(nts1_port_t *port)
+{
+  return s_fifo_pop(&port->rx_fifo);
+}
+
+void nts1_port_tx_push(nts1_port_t *port, uint8_t data)
+{
+  s_fifo_push(&port->tx_fifo, data);
+}
+
+void nts1_port_ack_set(nts1_port_t *port, uint8_t ready)
+{
+  port->ack = ready;
+}
+
+void nts1_port_irq_enable(nts1_port_t *port, uint8_t enable)
+{
+  port->irq_enabled = enable;
+}
+
+uint32_t nts1_port_critical_enter(nts1_port_t *port)
+{
+  pthread_mutex_lock(&port->lock);
+  return 0;
+}
+
+void nts1_port_critical_exit(nts1_port_t *port, uint32_t state)
+{
+  (void)state;
+  pthread_mutex_unlock(&port->lock);
+}
+
+// ----------------------------------------------------
+
+uint8_t nts1_port_host_transfer(nts1_port_t *port, uint8_t mosi)
+{
+  const uint32_t state = nts1_port_critical_enter(port);
+  // The byte going out was queued before this one came in
+  const uint8_t miso = s_fifo_count(&port->tx_fifo) ? s_fifo_pop(&port->tx_fifo) : 0xFF;
+  if (port->irq_enabled) {
+    s_fifo_push(&port->rx_fifo, mosi);
+    nts1_link_isr(port->link);
+  }
+  nts1_port_critical_exit(port, state);
+  return miso;
+}
+
+uint8_t nts1_port_host_ack(nts1_port_t *port)
+{
+  return port->ack;
+}
+
+void nts1_port_host_use_sim_clock(nts1_port_t *port, uint8_t enable)
+{
+  port->sim_clock = enable;
+}
+
+void nts1_port_host_advance_us(nts1_port_t *port, uint32_t us)
+{
+  port->sim_time_us += us;
+}
+
+#endif // !TARGET_LIKE_MBED
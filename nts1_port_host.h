@@ -0,0 +1,78 @@
+/** @file nts1_port_host.h
+ * @brief NTS-1 transport port for host builds (Linux, macOS).
+ *
+ * Replaces the SPI peripheral with an in-memory byte exchange so the
+ * protocol code can run unmodified against a simulated main board. The
+ * simulation clocks bytes with nts1_port_host_transfer(), which runs the
+ * link service routine exactly like the SPI interrupt would. All state is
+ * kept per port, so independent links can be driven from separate threads.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef __nts1_port_host_h
+#define __nts1_port_host_h
+
+#include <pthread.h>
+#include <stdint.h>
+
+/** Depth of the simulated SPI FIFOs, same as the STM32F0 SPI */
+#define NTS1_PORT_HOST_FIFO_SIZE 4
+
+/** Host "cycles" are nanoseconds of the monotonic clock */
+#define NTS1_PORT_CORE_HZ     1000000000UL
+#define NTS1_PORT_CYCLES_MASK 0xFFFFFFFFUL
+
+typedef struct nts1_port_host_fifo {
+  uint8_t buf[NTS1_PORT_HOST_FIFO_SIZE];
+  uint8_t ridx;
+  uint8_t widx;
+} nts1_port_host_fifo_t;
+
+typedef struct nts1_port {
+  struct nts1_link *link;
+  nts1_port_host_fifo_t rx_fifo;
+  nts1_port_host_fifo_t tx_fifo;
+  uint8_t  ack;
+  uint8_t  irq_enabled;
+  uint8_t  sim_clock;
+  uint32_t sim_time_us;
+  pthread_mutex_t lock; // recursive, stands in for interrupt masking
+} nts1_port_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  uint8_t  nts1_port_rx_ready(nts1_port_t *port);
+  uint8_t  nts1_port_rx_pop(nts1_port_t *port);
+  void     nts1_port_tx_push(nts1_port_t *port, uint8_t data);
+  void     nts1_port_ack_set(nts1_port_t *port, uint8_t ready);
+  void     nts1_port_irq_enable(nts1_port_t *port, uint8_t enable);
+  uint32_t nts1_port_critical_enter(nts1_port_t *port);
+  void     nts1_port_critical_exit(nts1_port_t *port, uint32_t state);
+  uint32_t nts1_port_cycles(nts1_port_t *port);
+
+  /**
+   * Clock one full duplex byte as the main board would: returns the byte
+   * the panel shifts out while mosi is shifted in, then runs the link
+   * service routine if the link interrupt is enabled.
+   */
+  uint8_t nts1_port_host_transfer(nts1_port_t *port, uint8_t mosi);
+
+  /**
+   * Current level of the ACK line, 0 = panel asks the main board to wait
+   */
+  uint8_t nts1_port_host_ack(nts1_port_t *port);
+
+  /**
+   * Use a simulated clock for nts1_port_timestamp() instead of the host
+   * monotonic clock, for deterministic simulations.
+   */
+  void nts1_port_host_use_sim_clock(nts1_port_t *port, uint8_t enable);
+  void nts1_port_host_advance_us(nts1_port_t *port, uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __nts1_port_host_h
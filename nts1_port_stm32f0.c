@@ -0,0 +1,215 @@
+/** 
+ * @file nts1_port_stm32f0.c
+ * @brief NTS-1 transport port for STM32F0 (SPI2 slave, interrupt driven).
+ *
+ * SPI2 on PB13 (SCK), PB14 (MISO), PB15 (MOSI) in slave mode, panel ACK
+ * on PB12. The RXNE interrupt runs the link service routine for every
+ * received byte.
+ *   
+ * BSD 3-Clause License
+ *  Copyright (c) 2020, KORG INC.
+ *  All rights reserved.
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ //*/
+
+#if defined(TARGET_STM32F0)
+
+#include "nts1_port.h"
+
+#include "stm32f0xx_hal.h"
+#include "stm32f0xx_hal_def.h"
+#include "stm32f0xx_hal_spi.h"
+#include "us_ticker_api.h"
+
+#define SPI_PERIPH       SPI2
+#define SPI_MISO_PORT    GPIOB
+#define SPI_MISO_PIN     GPIO_PIN_14
+#define SPI_MOSI_PORT    GPIOB
+#define SPI_MOSI_PIN     GPIO_PIN_15
+#define SPI_SCK_PORT     GPIOB
+#define SPI_SCK_PIN      GPIO_PIN_13
+#define SPI_GPIO_AF      GPIO_AF0_SPI2
+
+#define SPI_IRQn         SPI2_IRQn
+#define SPI_IRQ_PRIORITY 1
+#define SPI_IRQ_HANDLER  SPI2_IRQHandler
+
+#define SPI_GPIO_CLK_ENA()   __HAL_RCC_GPIOB_CLK_ENABLE()
+#define SPI_FORCE_RESET()    __HAL_RCC_SPI2_FORCE_RESET()
+#define SPI_RELEASE_RESET()  __HAL_RCC_SPI2_RELEASE_RESET()
+#define SPI_CLK_ENABLE()     __HAL_RCC_SPI2_CLK_ENABLE()
+#define SPI_CLK_DISABLE()    __HAL_RCC_SPI2_CLK_DISABLE()
+
+#define ACK_GPIO_CLK_ENABLE() __HAL_RCC_GPIOB_CLK_ENABLE()
+
+// ----------------------------------------------------
+
+static SPI_HandleTypeDef s_spi;
+static nts1_port_t *s_port; // link served by the SPI interrupt
+
+// ----------------------------------------------------
+
+static inline void s_spi_struct_init(SPI_InitTypeDef* SPI_InitStruct)
+{
+  SPI_InitStruct->Mode = SPI_MODE_SLAVE;
+  SPI_InitStruct->Direction = SPI_DIRECTION_2LINES;
+  SPI_InitStruct->DataSize = SPI_DATASIZE_8BIT;
+  SPI_InitStruct->CLKPolarity = SPI_POLARITY_HIGH;
+  SPI_InitStruct->CLKPhase = SPI_PHASE_2EDGE;
+  SPI_InitStruct->NSS = SPI_NSS_SOFT;
+  SPI_InitStruct->BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+  SPI_InitStruct->FirstBit = SPI_FIRSTBIT_LSB;
+  SPI_InitStruct->TIMode = SPI_TIMODE_DISABLE;
+  SPI_InitStruct->CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+  SPI_InitStruct->CRCPolynomial = 7;
+  SPI_InitStruct->CRCLength = SPI_CRC_LENGTH_DATASIZE;
+  SPI_InitStruct->NSSPMode = SPI_NSS_PULSE_DISABLE;
+}
+
+static inline void s_spi_enable_pins()
+{
+  SPI_GPIO_CLK_ENA();
+  
+  GPIO_InitTypeDef gpio;
+  
+  /* Enable SCK, MOSI, MISO. No NSS. */
+  /* Peripherals alternate function */
+  gpio.Mode = GPIO_MODE_AF_PP;
+  /* gpio.Speed = GPIO_SPEED_FREQ_HIGH;  */ 
+  gpio.Speed = GPIO_SPEED_FREQ_LOW; 
+  
+  gpio.Pull = GPIO_NOPULL;
+  gpio.Alternate = SPI_GPIO_AF;
+  
+  gpio.Pin = SPI_MISO_PIN;
+  HAL_GPIO_Init(SPI_MISO_PORT, &gpio);
+  
+  gpio.Pin = SPI_MOSI_PIN;
+  HAL_GPIO_Init(SPI_MOSI_PORT, &gpio);
+  
+  gpio.Pin = SPI_SCK_PIN;
+  gpio.Pull = GPIO_PULLUP;
+  HAL_GPIO_Init(SPI_SCK_PORT, &gpio);
+  
+}
+
+static HAL_StatusTypeDef s_spi_init()
+{
+  __HAL_RCC_SYSCFG_CLK_ENABLE();
+  
+  s_spi_enable_pins();
+  
+  SPI_FORCE_RESET();
+  SPI_RELEASE_RESET();
+  SPI_CLK_ENABLE();
+  
+  s_spi.Instance = SPI_PERIPH;
+  s_spi_struct_init(&(s_spi.Init));
+  
+  const HAL_StatusTypeDef res = HAL_SPI_Init(&s_spi);
+  if (res != HAL_OK) {
+    return res;
+  }
+
+  HAL_NVIC_SetPriority(SPI_IRQn, SPI_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(SPI_IRQn);
+  
+  SPI_PERIPH->CR2 |= SPI_IT_RXNE;
+
+  __HAL_SPI_ENABLE(&s_spi);
+
+  return HAL_OK;
+}
+
+// ----------------------------------------------------
+
+void nts1_port_setup(nts1_port_t *port, struct nts1_link *link)
+{
+  port->link = link;
+}
+
+uint8_t nts1_port_init(nts1_port_t *port)
+{
+  if (s_port != NULL && s_port != port)
+    return HAL_BUSY; // the SPI interrupt serves another link
+  s_port = port;
+  ACK_GPIO_CLK_ENABLE();
+  
+  GPIO_InitTypeDef gpio;
+
+  /* PANEL ACK */
+  gpio.Mode = GPIO_MODE_OUTPUT_PP;
+  gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+  gpio.Pull = GPIO_NOPULL;
+  gpio.Alternate = 0;
+  gpio.Pin = NTS1_PORT_ACK_PIN;
+  HAL_GPIO_Init(NTS1_PORT_ACK_PORT, &gpio);
+  
+  return (uint8_t)s_spi_init();
+}
+
+uint8_t nts1_port_teardown(nts1_port_t *port)
+{
+  if (s_port != port)
+    return HAL_OK;
+  HAL_NVIC_DisableIRQ(SPI_IRQn);
+  __HAL_SPI_DISABLE(&s_spi);
+  SPI_CLK_DISABLE();
+  s_port = NULL;
+  return HAL_OK;
+}
+
+void nts1_port_irq_enable(nts1_port_t *port, uint8_t enable)
+{
+  if (enable)
+    HAL_NVIC_EnableIRQ(SPI_IRQn);
+  else
+    HAL_NVIC_DisableIRQ(SPI_IRQn);
+}
+
+uint32_t nts1_port_timestamp(nts1_port_t *port)
+{
+  // us_ticker_read() is the raw counter, 16 bits on the F0 timers; the
+  // ticker layer extends it to 64 bits
+  return (uint32_t)ticker_read_us(get_us_ticker_data());
+}
+
+void nts1_port_cycles_init(nts1_port_t *port)
+{
+  // TIM17 is not used by mbed on this target; APB prescaler is 1 so it
+  // counts at the core clock
+  __HAL_RCC_TIM17_CLK_ENABLE();
+  NTS1_PORT_CYCLE_TIM->CR1 = 0;
+  NTS1_PORT_CYCLE_TIM->PSC = 0;
+  NTS1_PORT_CYCLE_TIM->ARR = 0xFFFF;
+  NTS1_PORT_CYCLE_TIM->EGR = TIM_EGR_UG;
+  NTS1_PORT_CYCLE_TIM->CR1 = TIM_CR1_CEN;
+}
+
+// ----------------------------------------------------
+
+void SPI_IRQ_HANDLER(void)
+{
+  nts1_link_isr(s_port->link);
+}
+
+#endif // TARGET_STM32F0
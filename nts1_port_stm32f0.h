@@ -0,0 +1,91 @@
+/** @file nts1_port_stm32f0.h
+ * @brief NTS-1 transport port for STM32F0 (SPI2 slave, interrupt driven).
+ *
+ * Hot path register accesses used by the link service routine. The SPI
+ * data register is accessed as 8 bit so the FIFO packs single bytes.
+ *
+ * @license: BSD 3-Clause License
+ */
+
+#ifndef __nts1_port_stm32f0_h
+#define __nts1_port_stm32f0_h
+
+#include <stdint.h>
+
+#include "stm32f0xx_hal.h"
+
+#define NTS1_PORT_SPI        SPI2
+#define NTS1_PORT_ACK_PORT   GPIOB
+#define NTS1_PORT_ACK_PIN    GPIO_PIN_12
+
+// ISR instrumentation: TIM17 free running at the 48 MHz core clock
+#define NTS1_PORT_CYCLE_TIM  TIM17
+#ifndef NTS1_PORT_CORE_HZ
+#define NTS1_PORT_CORE_HZ    48000000UL
+#endif
+#define NTS1_PORT_CYCLES_MASK 0xFFFFUL
+
+// Worst path of nts1_link_isr() per received byte: entry/exit, RX ring
+// write with space check and ACK update, TX pop with end mark check.
+// Counted from the -Os listing; compare with nts1_isr_stats_t.max_cycles.
+#ifndef NTS1_PORT_ISR_WORST_CYCLES
+#define NTS1_PORT_ISR_WORST_CYCLES 170
+#endif
+
+// One SPI peripheral, so one link per firmware
+typedef struct nts1_port {
+  struct nts1_link *link;
+} nts1_port_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  static inline uint8_t nts1_port_rx_ready(nts1_port_t *port)
+  {
+    return (NTS1_PORT_SPI->SR & SPI_SR_RXNE) != 0;
+  }
+
+  static inline uint8_t nts1_port_rx_pop(nts1_port_t *port)
+  {
+    //  The RXNE flag is cleared by reading DR
+    return *(__IO uint8_t *)&NTS1_PORT_SPI->DR;
+  }
+
+  static inline void nts1_port_tx_push(nts1_port_t *port, uint8_t data)
+  {
+    *(__IO uint8_t *)&NTS1_PORT_SPI->DR = data;
+  }
+
+  static inline void nts1_port_ack_set(nts1_port_t *port, uint8_t ready)
+  {
+    if (ready)
+      NTS1_PORT_ACK_PORT->BSRR = NTS1_PORT_ACK_PIN;
+    else
+      NTS1_PORT_ACK_PORT->BRR = NTS1_PORT_ACK_PIN;
+  }
+
+  void nts1_port_irq_enable(nts1_port_t *port, uint8_t enable);
+
+  static inline uint32_t nts1_port_critical_enter(nts1_port_t *port)
+  {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+  }
+
+  static inline void nts1_port_critical_exit(nts1_port_t *port, uint32_t state)
+  {
+    __set_PRIMASK(state);
+  }
+
+  static inline uint32_t nts1_port_cycles(nts1_port_t *port)
+  {
+    return NTS1_PORT_CYCLE_TIM->CNT;
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __nts1_port_stm32f0_h
@@ -0,0 +1,154 @@
+/** @file nts1_port_stm32f4.c
+ * @brief NTS-1 transport port for STM32F4 (SPI2 slave, DMA receive).
+ *
+ * SPI2 on PB13 (SCK), PB14 (MISO), PB15 (MOSI) in slave mode, panel ACK
+ * on PB12. DMA1 stream 3 channel 0 moves every received byte into a
+ * circular buffer, so bursts from the main board never overrun the SPI
+ * while the CPU is busy elsewhere. The TXE interrupt runs the link service
+ * routine once per byte slot.
+ *
+ * @license: BSD 3-Clause License
+ */
+#if defined(TARGET_STM32F4)
+
+#include "nts1_port.h"
+
+#include "stm32f4xx_hal.h"
+#include "us_ticker_api.h"
+
+#define SPI_IRQn         SPI2_IRQn
+#define SPI_IRQ_PRIORITY 1
+#define SPI_IRQ_HANDLER  SPI2_IRQHandler
+
+// ----------------------------------------------------
+
+uint8_t  nts1_port_dma_rx_buf[NTS1_PORT_DMA_RX_SIZE] __attribute__((aligned(4)));
+uint16_t nts1_port_dma_rx_tail;
+
+static nts1_port_t *s_port; // link served by the SPI interrupt
+
+// ----------------------------------------------------
+
+static void s_gpio_init(void)
+{
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+
+  GPIO_InitTypeDef gpio;
+
+  /* PANEL ACK */
+  gpio.Mode = GPIO_MODE_OUTPUT_PP;
+  gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+  gpio.Pull = GPIO_NOPULL;
+  gpio.Alternate = 0;
+  gpio.Pin = NTS1_PORT_ACK_PIN;
+  HAL_GPIO_Init(NTS1_PORT_ACK_PORT, &gpio);
+
+  /* SCK, MISO, MOSI. No NSS. */
+  gpio.Mode = GPIO_MODE_AF_PP;
+  gpio.Speed = GPIO_SPEED_FREQ_LOW;
+  gpio.Pull = GPIO_NOPULL;
+  gpio.Alternate = GPIO_AF5_SPI2;
+  gpio.Pin = GPIO_PIN_14 | GPIO_PIN_15;
+  HAL_GPIO_Init(GPIOB, &gpio);
+
+  gpio.Pull = GPIO_PULLUP;
+  gpio.Pin = GPIO_PIN_13;
+  HAL_GPIO_Init(GPIOB, &gpio);
+}
+
+static void s_rx_dma_init(void)
+{
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  NTS1_PORT_RX_DMA->CR &= ~DMA_SxCR_EN;
+  while (NTS1_PORT_RX_DMA->CR & DMA_SxCR_EN)
+    ;
+
+  nts1_port_dma_rx_tail = 0;
+
+  NTS1_PORT_RX_DMA->PAR  = (uint32_t)&NTS1_PORT_SPI->DR;
+  NTS1_PORT_RX_DMA->M0AR = (uint32_t)nts1_port_dma_rx_buf;
+  NTS1_PORT_RX_DMA->NDTR = NTS1_PORT_DMA_RX_SIZE;
+  NTS1_PORT_RX_DMA->FCR  = 0; // direct mode
+  // Channel 0 (SPI2_RX), peripheral to memory, 8 bit, circular, high priority
+  NTS1_PORT_RX_DMA->CR   = DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_PL_1;
+  NTS1_PORT_RX_DMA->CR  |= DMA_SxCR_EN;
+}
+
+static void s_spi_init(void)
+{
+  __HAL_RCC_SPI2_FORCE_RESET();
+  __HAL_RCC_SPI2_RELEASE_RESET();
+  __HAL_RCC_SPI2_CLK_ENABLE();
+
+  // Slave, CPOL=1, CPHA=1, LSB first, 8 bit, software NSS (selected)
+  NTS1_PORT_SPI->CR1 = SPI_CR1_CPOL | SPI_CR1_CPHA | SPI_CR1_LSBFIRST | SPI_CR1_SSM;
+  NTS1_PORT_SPI->CR2 = SPI_CR2_RXDMAEN;
+
+  s_rx_dma_init();
+
+  HAL_NVIC_SetPriority(SPI_IRQn, SPI_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(SPI_IRQn);
+
+  NTS1_PORT_SPI->CR2 |= SPI_CR2_TXEIE;
+  NTS1_PORT_SPI->CR1 |= SPI_CR1_SPE;
+}
+
+// ----------------------------------------------------
+
+void nts1_port_setup(nts1_port_t *port, struct nts1_link *link)
+{
+  port->link = link;
+}
+
+uint8_t nts1_port_init(nts1_port_t *port)
+{
+  if (s_port != NULL && s_port != port)
+    return HAL_BUSY; // the SPI interrupt serves another link
+  s_port = port;
+  s_gpio_init();
+  s_spi_init();
+  return HAL_OK;
+}
+
+uint8_t nts1_port_teardown(nts1_port_t *port)
+{
+  if (s_port != port)
+    return HAL_OK;
+  HAL_NVIC_DisableIRQ(SPI_IRQn);
+  NTS1_PORT_SPI->CR2 &= ~(SPI_CR2_TXEIE | SPI_CR2_RXDMAEN);
+  NTS1_PORT_SPI->CR1 &= ~SPI_CR1_SPE;
+  NTS1_PORT_RX_DMA->CR &= ~DMA_SxCR_EN;
+  __HAL_RCC_SPI2_CLK_DISABLE();
+  s_port = NULL;
+  return HAL_OK;
+}
+
+void nts1_port_irq_enable(nts1_port_t *port, uint8_t enable)
+{
+  if (enable)
+    HAL_NVIC_EnableIRQ(SPI_IRQn);
+  else
+    HAL_NVIC_DisableIRQ(SPI_IRQn);
+}
+
+uint32_t nts1_port_timestamp(nts1_port_t *port)
+{
+  return (uint32_t)ticker_read_us(get_us_ticker_data());
+}
+
+void nts1_port_cycles_init(nts1_port_t *port)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// ----------------------------------------------------
+
+void SPI_IRQ_HANDLER(void)
+{
+  nts1_link_isr(s_port->link);
+}
+
+#endif // TARGET_STM32F4
@@ -0,0 +1,90 @@
+/** @file nts1_port_stm32f4.h
+ * @brief NTS-1 transport port for STM32F4 (SPI2 slave, DMA receive).
+ *
+ * Received bytes are written by DMA1 stream 3 into a circular buffer, the
+ * RX "FIFO" is the part of that buffer the DMA has filled since the last
+ * pop. Transmit is one byte per TXE interrupt.
+ *
+ * @license: BSD 3-Clause License
+ */
+#ifndef __nts1_port_stm32f4_h
+#define __nts1_port_stm32f4_h
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+#define NTS1_PORT_SPI          SPI2
+#define NTS1_PORT_ACK_PORT     GPIOB
+#define NTS1_PORT_ACK_PIN      GPIO_PIN_12
+#define NTS1_PORT_RX_DMA       DMA1_Stream3
+
+#define NTS1_PORT_DMA_RX_SIZE  (64)
+#define NTS1_PORT_DMA_RX_MASK  (NTS1_PORT_DMA_RX_SIZE - 1)
+
+// ISR instrumentation: DWT cycle counter. Core clock differs per board,
+// override NTS1_PORT_CORE_HZ for the budget check when above 84 MHz.
+#ifndef NTS1_PORT_CORE_HZ
+#define NTS1_PORT_CORE_HZ      84000000UL
+#endif
+#define NTS1_PORT_CYCLES_MASK  0xFFFFFFFFUL
+
+// One SPI peripheral, so one link per firmware
+typedef struct nts1_port {
+  struct nts1_link *link;
+} nts1_port_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  extern uint8_t  nts1_port_dma_rx_buf[NTS1_PORT_DMA_RX_SIZE];
+  extern uint16_t nts1_port_dma_rx_tail;
+
+  static inline uint8_t nts1_port_rx_ready(nts1_port_t *port)
+  {
+    const uint16_t head = (NTS1_PORT_DMA_RX_SIZE - NTS1_PORT_RX_DMA->NDTR) & NTS1_PORT_DMA_RX_MASK;
+    return head != nts1_port_dma_rx_tail;
+  }
+
+  static inline uint8_t nts1_port_rx_pop(nts1_port_t *port)
+  {
+    const uint8_t data = nts1_port_dma_rx_buf[nts1_port_dma_rx_tail];
+    nts1_port_dma_rx_tail = (nts1_port_dma_rx_tail + 1) & NTS1_PORT_DMA_RX_MASK;
+    return data;
+  }
+
+  static inline void nts1_port_tx_push(nts1_port_t *port, uint8_t data)
+  {
+    *(__IO uint8_t *)&NTS1_PORT_SPI->DR = data;
+  }
+
+  static inline void nts1_port_ack_set(nts1_port_t *port, uint8_t ready)
+  {
+    NTS1_PORT_ACK_PORT->BSRR = ready ? NTS1_PORT_ACK_PIN : ((uint32_t)NTS1_PORT_ACK_PIN << 16);
+  }
+
+  void nts1_port_irq_enable(nts1_port_t *port, uint8_t enable);
+
+  static inline uint32_t nts1_port_critical_enter(nts1_port_t *port)
+  {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+  }
+
+  static inline void nts1_port_critical_exit(nts1_port_t *port, uint32_t state)
+  {
+    __set_PRIMASK(state);
+  }
+
+  static inline uint32_t nts1_port_cycles(nts1_port_t *port)
+  {
+    return DWT->CYCCNT;
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __nts1_port_stm32f4_h
@@ -0,0 +1,204 @@
+/** @file nts1_trace.c
+ * @brief Optional per-message latency tracing for the NTS-1 link.
+ *
+ * The link ISR keeps one RX stamp per frame in a 16 entry ring: a status
+ * byte opens an entry, every data byte moves its position and time on,
+ * so the entry ends up holding the frame's last byte. Dispatch finds the
+ * entry by RX buffer position, which works while fewer than 16 frames
+ * are queued. TX frames are stamped at enqueue in a 16 entry FIFO and
+ * completed when the link ISR reads their last byte.
+ *
+ * @license: BSD 3-Clause License
+ */
+
+#include "nts1_trace.h"
+
+#if NTS1_TRACE_LATENCY
+
+#include "nts1_link.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#define TRACE_STAMPS     NTS1_TRACE_STAMPS
+#define TRACE_STAMP_MASK (TRACE_STAMPS - 1)
+#define TRACE_BINS       NTS1_TRACE_BINS
+
+static const char *s_type_names[k_num_nts1_trace_type] = {
+  "rx note off",
+  "rx note on",
+  "rx step tick",
+  "rx unit desc",
+  "rx param desc",
+  "rx value",
+  "rx param",
+  "tx event",
+  "tx param",
+  "tx other",
+};
+
+// ----------------------------------------------------
+
+static uint8_t s_bin(uint32_t us)
+{
+  uint8_t bin = 0;
+  while ((us >>= 1) != 0 && bin < (TRACE_BINS - 1))
+    ++bin;
+  return bin;
+}
+
+// Callers hold the critical section (or run in the link ISR)
+static void s_record(nts1_trace_t *t, uint8_t type, uint32_t us)
+{
+  nts1_trace_hist_t *h = &t->hist[type];
+  if (h->count == 0 || us < h->min_us)
+    h->min_us = us;
+  if (us > h->max_us)
+    h->max_us = us;
+  h->count++;
+  h->sum_us += us;
+  uint16_t *bin = &h->bins[s_bin(us)];
+  if (*bin != 0xFFFF)
+    ++*bin;
+}
+
+// ----------------------------------------------------
+
+void nts1_trace_rx_byte(nts1_link_t *link, uint16_t idx, uint8_t data)
+{
+  nts1_trace_t *t = &link->trace;
+  if (data & 0x80) {
+    t->rx_in_frame = ((data & 0x07) != 0x07); // dummies carry no frame
+    if (!t->rx_in_frame)
+      return;
+    t->rx_stamp_cur = (t->rx_stamp_cur + 1) & TRACE_STAMP_MASK;
+  } else if (!t->rx_in_frame) {
+    return;
+  }
+  t->rx_stamp[t->rx_stamp_cur].pos = idx + 1;
+  t->rx_stamp[t->rx_stamp_cur].us = nts1_port_timestamp(&link->port);
+}
+
+void nts1_trace_rx_read(nts1_link_t *link, uint16_t idx)
+{
+  link->trace.rx_read_idx = idx;
+}
+
+void nts1_trace_rx_dispatch(nts1_link_t *link, uint8_t type)
+{
+  assert(type < k_num_nts1_trace_type);
+  nts1_trace_t *t = &link->trace;
+  const uint32_t now = nts1_port_timestamp(&link->port);
+  const uint32_t state = nts1_port_critical_enter(&link->port);
+  uint8_t slot = 0;
+  while (slot < TRACE_STAMPS && t->rx_stamp[slot].pos != t->rx_read_idx + 1)
+    ++slot;
+  if (slot < TRACE_STAMPS)
+    s_record(t, type, now - t->rx_stamp[slot].us);
+  else
+    t->hist[type].missed++;
+  nts1_port_critical_exit(&link->port, state);
+}
+
+// Called from s_spi_tx_frame_write() inside its critical section
+void nts1_trace_tx_queued(nts1_link_t *link, uint8_t type, uint16_t end_idx)
+{
+  assert(type < k_num_nts1_trace_type);
+  nts1_trace_t *t = &link->trace;
+  const uint8_t next = (t->tx_tail + 1) & TRACE_STAMP_MASK;
+  if (next == t->tx_head) {
+    t->hist[type].missed++;
+    return;
+  }
+  t->tx_pending[t->tx_tail].end_idx = end_idx;
+  t->tx_pending[t->tx_tail].type = type;
+  t->tx_pending[t->tx_tail].us = nts1_port_timestamp(&link->port);
+  t->tx_tail = next;
+}
+
+// Called from the link ISR with the TX read index after the byte was taken
+void nts1_trace_tx_byte(nts1_link_t *link, uint16_t next_idx)
+{
+  nts1_trace_t *t = &link->trace;
+  if (t->tx_head == t->tx_tail || t->tx_pending[t->tx_head].end_idx != next_idx)
+    return;
+  s_record(t, t->tx_pending[t->tx_head].type,
+           nts1_port_timestamp(&link->port) - t->tx_pending[t->tx_head].us);
+  t->tx_head = (t->tx_head + 1) & TRACE_STAMP_MASK;
+}
+
+// TX ring was emptied without sending, pending stamps are void
+void nts1_trace_tx_flush(nts1_link_t *link)
+{
+  link->trace.tx_head = link->trace.tx_tail;
+}
+
+// ----------------------------------------------------
+
+void nts1_trace_get_summary(nts1_link_t *link, uint8_t type, nts1_trace_summary_t *summary)
+{
+  assert(type < k_num_nts1_trace_type);
+  assert(summary != NULL);
+  nts1_trace_hist_t h;
+  const uint32_t state = nts1_port_critical_enter(&link->port);
+  h = link->trace.hist[type];
+  nts1_port_critical_exit(&link->port, state);
+
+  summary->count = h.count;
+  summary->missed = h.missed;
+  summary->min_us = h.min_us;
+  summary->max_us = h.max_us;
+  summary->mean_us = h.count ? h.sum_us / h.count : 0;
+  summary->p99_us = 0;
+  if (h.count == 0)
+    return;
+
+  // Bins saturate, so rank against their own total
+  uint32_t total = 0;
+  for (uint8_t b = 0; b < TRACE_BINS; ++b)
+    total += h.bins[b];
+  const uint32_t rank = total - total / 100;
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < TRACE_BINS; ++b) {
+    seen += h.bins[b];
+    if (seen >= rank) {
+      const uint32_t edge = (2UL << b) - 1;
+      summary->p99_us = (edge < h.max_us) ? edge : h.max_us;
+      break;
+    }
+  }
+}
+
+void nts1_trace_reset(nts1_link_t *link)
+{
+  const uint32_t state = nts1_port_critical_enter(&link->port);
+  for (uint8_t t = 0; t < k_num_nts1_trace_type; ++t) {
+    nts1_trace_hist_t *h = &link->trace.hist[t];
+    h->count = h->missed = h->sum_us = h->min_us = h->max_us = 0;
+    for (uint8_t b = 0; b < TRACE_BINS; ++b)
+      h->bins[b] = 0;
+  }
+  nts1_port_critical_exit(&link->port, state);
+}
+
+const char *nts1_trace_type_name(uint8_t type)
+{
+  return (type < k_num_nts1_trace_type) ? s_type_names[type] : "?";
+}
+
+void nts1_trace_print(nts1_link_t *link)
+{
+  nts1_trace_summary_t s;
+  printf("latency us: type count missed min mean p99 max\r\n");
+  for (uint8_t t = 0; t < k_num_nts1_trace_type; ++t) {
+    nts1_trace_get_summary(link, t, &s);
+    if (s.count == 0 && s.missed == 0)
+      continue;
+    printf("%s %lu %lu %lu %lu %lu %lu\r\n", s_type_names[t],
+           (unsigned long)s.count, (unsigned long)s.missed,
+           (unsigned long)s.min_us, (unsigned long)s.mean_us,
+           (unsigned long)s.p99_us, (unsigned long)s.max_us);
+  }
+}
+
+#endif // NTS1_TRACE_LATENCY
@@ -0,0 +1,137 @@
+/** @file nts1_trace.h
+ * @brief Optional per-message latency tracing for the NTS-1 link.
+ *
+ * RX: time from the last byte of a frame entering the RX ring (link ISR)
+ * to its handler being called from nts1_idle().
+ * TX: time from a frame being queued to its last byte being handed to the
+ * SPI data register.
+ * Each message type keeps a log2 histogram with count, min, mean, p99 and
+ * max in RAM, per link. Enabled with the nts1-trace-latency config option
+ * (or NTS1_TRACE_LATENCY=1); when disabled the hooks compile to nothing.
+ *
+ * @license: BSD 3-Clause License
+ */
+
+#ifndef __nts1_trace_h
+#define __nts1_trace_h
+
+#include <stdint.h>
+
+#if !defined(NTS1_TRACE_LATENCY)
+#if defined(MBED_CONF_APP_NTS1_TRACE_LATENCY)
+#define NTS1_TRACE_LATENCY MBED_CONF_APP_NTS1_TRACE_LATENCY
+#else
+#define NTS1_TRACE_LATENCY 0
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  enum {
+    k_nts1_trace_rx_note_off = 0U,
+    k_nts1_trace_rx_note_on,
+    k_nts1_trace_rx_step_tick,
+    k_nts1_trace_rx_unit_desc,
+    k_nts1_trace_rx_edit_param_desc,
+    k_nts1_trace_rx_value,
+    k_nts1_trace_rx_param_change,
+    k_nts1_trace_tx_event,
+    k_nts1_trace_tx_param_change,
+    k_nts1_trace_tx_other,
+    k_num_nts1_trace_type
+  };
+
+  typedef struct nts1_trace_summary {
+    uint32_t count;   // frames measured
+    uint32_t missed;  // frames whose stamp was overwritten before dispatch
+    uint32_t min_us;
+    uint32_t mean_us;
+    uint32_t p99_us;  // upper edge of the log2 bin holding the 99th percentile
+    uint32_t max_us;
+  } nts1_trace_summary_t;
+
+#if NTS1_TRACE_LATENCY
+
+#define NTS1_TRACE_STAMPS 16U  // power of two
+#define NTS1_TRACE_BINS   16U  // bin b holds [2^b, 2^(b+1)) us, last bin open ended
+
+  typedef struct nts1_trace_hist {
+    uint32_t count;
+    uint32_t missed;
+    uint32_t sum_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint16_t bins[NTS1_TRACE_BINS];
+  } nts1_trace_hist_t;
+
+  // Trace state of one link, lives in nts1_link_t
+  typedef struct nts1_trace {
+    nts1_trace_hist_t hist[k_num_nts1_trace_type];
+    struct {
+      uint16_t pos;  // RX buffer index + 1, 0 = unused
+      uint32_t us;
+    } rx_stamp[NTS1_TRACE_STAMPS];
+    uint8_t  rx_stamp_cur;   // entry of the frame being received
+    uint8_t  rx_in_frame;
+    uint16_t rx_read_idx;
+    struct {
+      uint16_t end_idx;
+      uint8_t  type;
+      uint32_t us;
+    } tx_pending[NTS1_TRACE_STAMPS];
+    uint8_t  tx_head;
+    uint8_t  tx_tail;
+  } nts1_trace_t;
+
+  struct nts1_link;
+
+  /**
+   * Read the latency summary of one message type (k_nts1_trace_*)
+   */
+  void nts1_trace_get_summary(struct nts1_link *link, uint8_t type, nts1_trace_summary_t *summary);
+
+  /**
+   * Clear all histograms
+   */
+  void nts1_trace_reset(struct nts1_link *link);
+
+  /**
+   * Print one line per message type that has samples
+   */
+  void nts1_trace_print(struct nts1_link *link);
+
+  const char *nts1_trace_type_name(uint8_t type);
+
+  // Hooks called by nts1_iface.c, use the NTS1_TRACE_* macros below
+  void nts1_trace_rx_byte(struct nts1_link *link, uint16_t idx, uint8_t data);
+  void nts1_trace_rx_read(struct nts1_link *link, uint16_t idx);
+  void nts1_trace_rx_dispatch(struct nts1_link *link, uint8_t type);
+  void nts1_trace_tx_queued(struct nts1_link *link, uint8_t type, uint16_t end_idx);
+  void nts1_trace_tx_byte(struct nts1_link *link, uint16_t next_idx);
+  void nts1_trace_tx_flush(struct nts1_link *link);
+
+#define NTS1_TRACE_RX_BYTE(link, idx, data)       nts1_trace_rx_byte(link, idx, data)
+#define NTS1_TRACE_RX_READ(link, idx)             nts1_trace_rx_read(link, idx)
+#define NTS1_TRACE_RX_DISPATCH(link, type)        nts1_trace_rx_dispatch(link, type)
+#define NTS1_TRACE_TX_QUEUED(link, type, end_idx) nts1_trace_tx_queued(link, type, end_idx)
+#define NTS1_TRACE_TX_BYTE(link, next_idx)        nts1_trace_tx_byte(link, next_idx)
+#define NTS1_TRACE_TX_FLUSH(link)                 nts1_trace_tx_flush(link)
+
+#else
+
+#define NTS1_TRACE_RX_BYTE(link, idx, data)       do { } while (0)
+#define NTS1_TRACE_RX_READ(link, idx)             do { } while (0)
+#define NTS1_TRACE_RX_DISPATCH(link, type)        do { } while (0)
+#define NTS1_TRACE_TX_QUEUED(link, type, end_idx) do { } while (0)
+#define NTS1_TRACE_TX_BYTE(link, next_idx)        do { } while (0)
+#define NTS1_TRACE_TX_FLUSH(link)                 do { } while (0)
+
+#endif // NTS1_TRACE_LATENCY
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __nts1_trace_h
@@ -0,0 +1,129 @@
+/** @file binlog.cpp
+ *
+ * Host test for BinLog and tools/binlog_decode.py: records mixed with
+ * plain text are written to a capture, decoded by the script and
+ * compared line by line. Covers a string longer than MAX_STRING, which
+ * is cut, and an overflowing ring, whose drops come out as one LOST
+ * record once the reader made room.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "BinLog.hpp"
+
+#ifndef REPO_ROOT
+#define REPO_ROOT "."
+#endif
+
+static const char *kCapture = REPO_ROOT "/test/build/binlog.bin";
+static const unsigned kOverflowRecords = 100;
+
+
+/** Move everything queued to the capture, a chunk at a time like drain() */
+static void drainTo(BinLog &log, FILE *f)
+{
+	uint8_t chunk[64];
+	uint16_t n;
+	while ((n = log.read(chunk, sizeof(chunk))) > 0) {
+		fwrite(chunk, 1, n, f);
+	}
+}
+
+
+int main()
+{
+	BinLog log;
+	std::string expected;
+	FILE *f = fopen(kCapture, "wb");
+	if (f == nullptr) {
+		printf("FAIL: cannot write %s\n", kCapture);
+		return 1;
+	}
+
+	fputs("boot\r\n", f);
+	expected += "boot\r\n";
+	log.log(BinLog::PARAM, "FILT_CUTOFF", 512);
+	log.log(BinLog::INIT_DONE, 2);
+	drainTo(log, f);
+	expected += "FILT_CUTOFF: 512\r\ninit done, filter type 2\r\n";
+
+	fputs("sw2 report\r\n", f);		// printf after flush()
+	expected += "sw2 report\r\n";
+	log.log(BinLog::PARAM, "A_VERY_LONG_PARAMETER_NAME", 7);
+	log.log(BinLog::RIBBON_NOTE, 3, 60);
+	log.log(BinLog::INIT_NO_REPLY);
+	drainTo(log, f);
+	expected += "A_VERY_LONG_PAR: 7\r\nribbon zone 3 note 60\r\n"
+		"init done, no reply from main board\r\n";
+
+	// Overflow: 6 byte records, the ring takes RING_SIZE / 6 of them
+	const unsigned fits = BinLog::RING_SIZE / 6;
+	for (unsigned i = 0; i < kOverflowRecords; i++) {
+		log.log(BinLog::INIT_DONE, i);
+	}
+	drainTo(log, f);
+	char line[64];
+	for (unsigned i = 0; i < fits; i++) {
+		snprintf(line, sizeof(line), "init done, filter type %u\r\n", i);
+		expected += line;
+	}
+	snprintf(line, sizeof(line), "binlog: %u records lost\r\n", kOverflowRecords - fits);
+	expected += line;
+	fclose(f);
+
+	bool ok = true;
+	if (log.lost() != kOverflowRecords - fits) {
+		printf("FAIL: lost() is %lu, expected %u\n", (unsigned long)log.lost(),
+			   kOverflowRecords - fits);
+		ok = false;
+	}
+
+	std::string decoded;
+	FILE *p = popen("python3 " REPO_ROOT "/tools/binlog_decode.py " REPO_ROOT
+					"/test/build/binlog.bin", "r");
+	if (p == nullptr) {
+		printf("FAIL: cannot run the decoder\n");
+		return 1;
+	}
+	char buf[256];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), p)) > 0) {
+		decoded.append(buf, n);
+	}
+	if (pclose(p) != 0) {
+		printf("FAIL: decoder exited with an error\n");
+		ok = false;
+	}
+
+	// Compare line by line so a mismatch shows where
+	size_t a = 0;
+	size_t b = 0;
+	unsigned lines = 0;
+	while (a < expected.size() || b < decoded.size()) {
+		const size_t ea = expected.find('\n', a);
+		const size_t eb = decoded.find('\n', b);
+		const std::string want = expected.substr(a, ea == std::string::npos ? ea : ea - a);
+		const std::string got = decoded.substr(b, eb == std::string::npos ? eb : eb - b);
+		if (want != got) {
+			printf("FAIL: line %u decoded as \"%s\", expected \"%s\"\n",
+				   lines + 1, got.c_str(), want.c_str());
+			ok = false;
+			break;
+		}
+		lines++;
+		a = (ea == std::string::npos) ? expected.size() : ea + 1;
+		b = (eb == std::string::npos) ? decoded.size() : eb + 1;
+	}
+	if (ok) {
+		printf("%u lines decoded, %u of %u overflow records reported lost\n",
+			   lines, kOverflowRecords - fits, kOverflowRecords);
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
+
+/* EOF */
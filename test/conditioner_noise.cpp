@@ -0,0 +1,91 @@
+/** @file conditioner_noise.cpp
+ *
+ * Host test for AnalogConditioner: how many control changes per second
+ * ADC noise produces with and without conditioning. The firmware feeds
+ * the conditioner once per 1.5 kHz ADC block and wakes the controls task
+ * on every output change, so changes are counted per block: raw, every
+ * block whose value differs from the one before; conditioned, every
+ * change the conditioner reports. Fails when conditioning lets more than
+ * MAX_COND_PER_S noise changes through, when a real step takes longer
+ * than MAX_SETTLE_MS or when the ends of the range cannot be reached.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include "AnalogConditioner.hpp"
+
+static const int kRateHz = 1488;		// ADC block rate
+static const int kSeconds = 10;
+static const double MAX_COND_PER_S = 0.5;
+static const double MIN_RAW_PER_S = 500.0;	// the noise must be visible raw
+static const double MAX_SETTLE_MS = 50.0;
+
+
+int main()
+{
+	bool ok = true;
+
+	for (int noise = 1; noise <= 4; noise++) {
+		srand(1);
+		AnalogConditioner cond;
+		// The first sample primes the filter, it is not noise
+		int lastRaw = 512 + (rand() % (2 * noise + 1)) - noise;
+		cond.update((uint16_t)lastRaw);
+		const uint32_t primed = cond.changes();
+		unsigned rawChanges = 0;
+		unsigned reported = 0;
+		for (int n = 1; n < kRateHz * kSeconds; n++) {
+			const int raw = 512 + (rand() % (2 * noise + 1)) - noise;
+			if (raw != lastRaw) {
+				rawChanges++;
+			}
+			lastRaw = raw;
+			if (cond.update((uint16_t)raw)) {
+				reported++;
+			}
+		}
+		// Every change wakes the task, the counter must agree
+		const unsigned condChanges = cond.changes() - primed;
+		if (condChanges != reported) {
+			printf("changes() %u but update() reported %u\n", condChanges, reported);
+			ok = false;
+		}
+		const double rawPerS = (double)rawChanges / kSeconds;
+		const double condPerS = (double)condChanges / kSeconds;
+		const bool pass = condPerS <= MAX_COND_PER_S && rawPerS >= MIN_RAW_PER_S;
+		printf("noise +-%d LSB: raw %.1f changes/s, conditioned %.2f changes/s %s\n",
+			   noise, rawPerS, condPerS, pass ? "ok" : "FAIL");
+		ok &= pass;
+	}
+
+	AnalogConditioner step;
+	step.update(100);
+	int samples = 0;
+	while (abs((int)step.value() - 900) > 2 && samples < 10000) {
+		step.update(900);
+		samples++;
+	}
+	const double settleMs = samples * 1000.0 / kRateHz;
+	const bool settled = settleMs <= MAX_SETTLE_MS;
+	printf("step 100 -> 900 settles in %d samples (%.1f ms) %s\n",
+		   samples, settleMs, settled ? "ok" : "FAIL");
+	ok &= settled;
+
+	for (int i = 0; i < 200; i++) {
+		step.update(0);
+	}
+	const bool bottom = step.value() == 0;
+	for (int i = 0; i < 200; i++) {
+		step.update(1023);
+	}
+	const bool top = step.value() == 1023;
+	printf("range ends reached: %s\n", (bottom && top) ? "ok" : "FAIL");
+	ok &= bottom && top;
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,130 @@
+/** @file control_map.cpp
+ *
+ * Host test for ControlMap with the real ModulationScheduler: a control
+ * change evaluates only the mappings of that control, a switch-only
+ * combination sends outMax when completed and outMin on release, and an
+ * override changes the source until it is cleared. Sent values are read
+ * back from the BinLog echo.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include <cstdio>
+#include <cstring>
+
+#include "ControlMap.hpp"
+
+enum { kRibbon, kPot, kControls };
+
+#define SW(n) (1U << ((n) - 1))
+static const ControlMap::Mapping kMappings[] = {
+	ControlMap::map<NTS1::FiltPeak>("FILT_PEAK", kRibbon, SW(1), 100),
+	ControlMap::map<NTS1::OscShape>("OSC_SHAPE", kPot, SW(7), 100),
+	ControlMap::map<NTS1::FiltLfoDepth>("FILT_LFO_DEPTH", kRibbon, SW(9), 50),
+	ControlMap::map<NTS1::FiltCutoff>("FILT_CUTOFF", kPot, SW(10), 200,
+		ModulationScheduler::Priority::HIGH, ControlMap::Curve::EXP),
+	ControlMap::map<NTS1::RevTime>("REV_TIME", kPot, SW(8), 50),
+	ControlMap::map<NTS1::DelTime>("DEL_TIME", ControlMap::NO_CONTROL,
+		SW(2) | SW(3), 10, ModulationScheduler::Priority::NORMAL,
+		ControlMap::Curve::LINEAR, 0, 1),
+};
+#undef SW
+
+static bool sOk = true;
+
+static void check(bool pass, const char *what)
+{
+	printf("%-60s %s\n", what, pass ? "ok" : "FAIL");
+	sOk &= pass;
+}
+
+/** Next PARAM record in the echo, false when there is none */
+static bool nextParam(BinLog &log, char *name, uint32_t *value)
+{
+	uint8_t head[3];
+	if (log.read(head, 3) != 3 || head[0] != BinLog::SYNC || head[1] != BinLog::PARAM) {
+		return false;
+	}
+	uint8_t rest[BinLog::MAX_STRING + 4];
+	if (log.read(rest, head[2] + 4) != head[2] + 4) {
+		return false;
+	}
+	memcpy(name, rest, head[2]);
+	name[head[2]] = '\0';
+	*value = rest[head[2]] | (rest[head[2] + 1] << 8)
+		| ((uint32_t)rest[head[2] + 2] << 16) | ((uint32_t)rest[head[2] + 3] << 24);
+	return true;
+}
+
+static void settle(AnalogConditioner &control, uint16_t value)
+{
+	for (int i = 0; i < 200; i++) {
+		control.update(value);
+	}
+	control.takeChange();
+}
+
+
+int main()
+{
+	NTS1 nts1;
+	ModulationScheduler modulation(nts1);
+	AnalogConditioner controls[kControls];
+	ControlMap map(modulation, controls, kControls);
+	BinLog log;
+	map.setEcho(&log);
+
+	const uint8_t count = sizeof(kMappings) / sizeof(kMappings[0]);
+	check(map.begin(kMappings, count) == count, "every mapping gets a stream");
+
+	char name[BinLog::MAX_STRING + 1];
+	uint32_t value;
+
+	// A pot change visits the three pot mappings only, sends for the held one
+	settle(controls[kPot], 1023);
+	uint32_t before = map.evaluations();
+	map.controlChanged(kPot, 1U << 9);
+	check(map.evaluations() - before == 3, "pot change evaluates the 3 pot mappings of 6");
+	check(nextParam(log, name, &value) && strcmp(name, "FILT_CUTOFF") == 0
+		  && value == NTS1::FiltCutoff::max, "held sw10 sends FILT_CUTOFF at full scale");
+	check(!nextParam(log, name, &value), "nothing else is sent");
+
+	// Nothing held: evaluated, not sent
+	before = map.evaluations();
+	map.controlChanged(kRibbon, 0);
+	check(map.evaluations() - before == 2, "ribbon change evaluates the 2 ribbon mappings");
+	check(!nextParam(log, name, &value), "no modifier held, nothing sent");
+
+	// Switch-only combination sw2 + sw3
+	map.switchesChanged(1U << 1, 1U << 1, 0);
+	check(!nextParam(log, name, &value), "half a combination sends nothing");
+	map.switchesChanged((1U << 1) | (1U << 2), 1U << 2, 0);
+	check(nextParam(log, name, &value) && strcmp(name, "DEL_TIME") == 0 && value == 1,
+		  "completing sw2 + sw3 sends outMax");
+	map.switchesChanged(1U << 1, 0, 1U << 2);
+	check(nextParam(log, name, &value) && strcmp(name, "DEL_TIME") == 0 && value == 0,
+		  "releasing sw3 sends outMin");
+	map.switchesChanged(0, 0, 1U << 1);
+	check(!nextParam(log, name, &value), "releasing the rest sends nothing more");
+
+	// Override: REV_TIME follows the ribbon until cleared
+	ControlMap::Mapping moved = *map.entry(4);
+	moved.control = kRibbon;
+	check(map.setOverride(4, moved), "override accepted");
+	settle(controls[kRibbon], 0);
+	before = map.evaluations();
+	map.controlChanged(kRibbon, 1U << 7);
+	check(map.evaluations() - before == 3, "overridden mapping moves to the ribbon");
+	check(nextParam(log, name, &value) && strcmp(name, "REV_TIME") == 0 && value == 0,
+		  "ribbon now drives REV_TIME");
+	map.clearOverride(4);
+	before = map.evaluations();
+	map.controlChanged(kPot, 1U << 7);
+	check(map.evaluations() - before == 3, "cleared override is back on the pot");
+	check(nextParam(log, name, &value) && strcmp(name, "REV_TIME") == 0
+		  && value == NTS1::RevTime::max, "pot drives REV_TIME again");
+
+	printf("%s\n", sOk ? "PASS" : "FAIL");
+	return sOk ? 0 : 1;
+}
+
+/* EOF */
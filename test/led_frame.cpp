@@ -0,0 +1,101 @@
+/** @file led_frame.cpp
+ *
+ * Host test for LedFrame, the hardware free half of LedDriver: each LED
+ * is on for exactly its level out of MAX_LEVEL slot units per frame,
+ * set and reset bits never overlap in a BSRR word, every pin is driven
+ * in every plane, and the planes are rebuilt only after a change.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include <cstdio>
+
+#include "LedDriver.hpp"
+
+// Same layout as the panel: four ports, pins shared within a port
+static const LedFrame::Pin kPins[LedFrame::LEDS] = {
+	{ 2, 10 }, { 2, 12 }, { 3, 6 }, { 3, 7 },
+	{ 0, 15 }, { 1, 7 }, { 2, 13 }, { 2, 14 },
+};
+
+static bool sOk = true;
+
+static void check(bool pass, const char *what)
+{
+	printf("%-52s %s\n", what, pass ? "ok" : "FAIL");
+	sOk &= pass;
+}
+
+/** On-time of one LED over a frame, in slot units (plane n lasts 1 << n) */
+static unsigned onTime(const LedFrame &frame, uint8_t led)
+{
+	unsigned units = 0;
+	for (uint8_t b = 0; b < LedFrame::BITS; b++) {
+		const uint32_t word = frame.plane(b)[kPins[led].port];
+		if (word & (1UL << kPins[led].pin)) {
+			units += 1U << b;
+		}
+	}
+	return units;
+}
+
+/** No pin both set and reset, every LED pin either set or reset */
+static bool planesConsistent(const LedFrame &frame)
+{
+	uint32_t used[LedFrame::PORTS] = {};
+	for (const LedFrame::Pin &p: kPins) {
+		used[p.port] |= 1UL << p.pin;
+	}
+	for (uint8_t b = 0; b < LedFrame::BITS; b++) {
+		for (uint8_t p = 0; p < LedFrame::PORTS; p++) {
+			const uint32_t word = frame.plane(b)[p];
+			const uint32_t set = word & 0xFFFFU;
+			const uint32_t reset = word >> 16;
+			if ((set & reset) != 0 || (set | reset) != used[p]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+int main()
+{
+	LedFrame frame(kPins);
+
+	bool exact = true;
+	bool consistent = true;
+	for (uint8_t level = 0; level <= LedFrame::MAX_LEVEL; level++) {
+		// Every LED a different level, rotated so each LED sees each level
+		for (uint8_t led = 0; led < LedFrame::LEDS; led++) {
+			frame.set(led, (uint8_t)((level + led) % (LedFrame::MAX_LEVEL + 1)));
+		}
+		frame.build();
+		for (uint8_t led = 0; led < LedFrame::LEDS; led++) {
+			exact &= onTime(frame, led) == frame.get(led);
+		}
+		consistent &= planesConsistent(frame);
+	}
+	check(exact, "on-time equals the level for every LED and level");
+	check(consistent, "BSRR set and reset bits never overlap");
+
+	frame.set(0, 200);
+	check(frame.get(0) == LedFrame::MAX_LEVEL, "levels above MAX_LEVEL clamp");
+	frame.set(LedFrame::LEDS, 5);		// ignored, no out of bounds write
+
+	frame.write(0xA5);
+	check(frame.build(), "write() marks the frame changed");
+	bool mask = true;
+	for (uint8_t led = 0; led < LedFrame::LEDS; led++) {
+		mask &= onTime(frame, led) == (((0xA5 >> led) & 1U) ? LedFrame::MAX_LEVEL : 0U);
+	}
+	check(mask, "write(mask) drives LEDs fully on or off");
+	check(!frame.build(), "no rebuild without a change");
+	frame.set(3, 7);
+	check(frame.build() && onTime(frame, 3) == 7, "rebuild after set()");
+
+	printf("%s\n", sOk ? "PASS" : "FAIL");
+	return sOk ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,121 @@
+/** @file response_curve.cpp
+ *
+ * Host test for ResponseCurve: every curve is monotonic over 0..1023 and
+ * hits both endpoints exactly, table points are within 0.5 LSB of the
+ * ideal curve (libm, not the constexpr helpers) and interpolation stays
+ * within MAX_ERROR_LSB of it everywhere. Stepped has STEPS values.
+ *
+ * @license: BSD 3-Clause License
+ */
+#include <cmath>
+#include <cstdio>
+
+#include "ResponseCurve.hpp"
+
+static const double MAX_ERROR_LSB = 5.0;
+
+typedef ResponseCurve::Type Type;
+
+static bool sOk = true;
+
+static void check(bool pass, const char *curve, const char *what)
+{
+	printf("%-8s %-44s %s\n", curve, what, pass ? "ok" : "FAIL");
+	sOk &= pass;
+}
+
+/** Ideal curve at x in 0..1, in 10 bit units */
+static double ideal(Type type, double x)
+{
+	const double k = ResponseCurveGen::K;
+	switch (type) {
+	case Type::EXP:
+		return (exp(k * x) - 1.0) / (exp(k) - 1.0) * ResponseCurve::MAX;
+	case Type::LOG:
+		return log(1.0 + (exp(k) - 1.0) * x) / k * ResponseCurve::MAX;
+	case Type::S_CURVE:
+		return x * x * (3.0 - 2.0 * x) * ResponseCurve::MAX;
+	default:
+		return x * ResponseCurve::MAX;
+	}
+}
+
+/** Largest distance of the table points from the ideal curve */
+static double pointError(Type type, const uint16_t *points, uint8_t count,
+						 uint16_t (*inputOf)(uint8_t))
+{
+	double worst = 0.0;
+	for (uint8_t i = 0; i < count; i++) {
+		const double e = fabs(points[i] - ideal(type, inputOf(i) / 1024.0));
+		worst = (e > worst) ? e : worst;
+	}
+	return worst;
+}
+
+static uint16_t uniformInput(uint8_t i)
+{
+	return (uint16_t)i << ResponseCurveGen::SEGMENT_BITS;
+}
+
+static uint16_t logInput(uint8_t i)
+{
+	return (i < ResponseCurveGen::FINE_POINTS)
+		? (uint16_t)i << ResponseCurveGen::FINE_BITS
+		: ResponseCurveGen::FINE_END
+			+ ((uint16_t)(i - ResponseCurveGen::FINE_POINTS) << ResponseCurveGen::SEGMENT_BITS);
+}
+
+
+int main()
+{
+	static const struct {
+		Type type;
+		const char *name;
+	} kCurves[] = {
+		{ Type::LINEAR, "linear" },
+		{ Type::EXP, "exp" },
+		{ Type::LOG, "log" },
+		{ Type::S_CURVE, "s-curve" },
+		{ Type::STEPPED, "stepped" },
+	};
+
+	for (const auto &c: kCurves) {
+		bool monotonic = true;
+		double worst = 0.0;
+		uint8_t distinct = 1;
+		uint16_t prev = ResponseCurve::apply(c.type, 0);
+		for (uint16_t v = 1; v <= ResponseCurve::MAX; v++) {
+			const uint16_t y = ResponseCurve::apply(c.type, v);
+			monotonic &= y >= prev;
+			distinct += (y != prev);
+			prev = y;
+			const double e = fabs(y - ideal(c.type, v / (double)ResponseCurve::MAX));
+			worst = (e > worst) ? e : worst;
+		}
+		check(monotonic, c.name, "monotonic");
+		check(ResponseCurve::apply(c.type, 0) == 0
+			  && ResponseCurve::apply(c.type, ResponseCurve::MAX) == ResponseCurve::MAX,
+			  c.name, "exact endpoints");
+		check(ResponseCurve::apply(c.type, 5000) == ResponseCurve::MAX, c.name,
+			  "input above 1023 clamps");
+		if (c.type == Type::STEPPED) {
+			check(distinct == ResponseCurve::STEPS, c.name, "STEPS distinct values");
+		} else {
+			char what[64];
+			snprintf(what, sizeof(what), "interpolation error %.2f LSB", worst);
+			check(worst <= MAX_ERROR_LSB, c.name, what);
+		}
+	}
+
+	check(pointError(Type::EXP, ResponseCurve::EXP_LUT.points, ResponseCurveGen::POINTS,
+					 uniformInput) <= 0.5, "exp", "table points within 0.5 LSB");
+	check(pointError(Type::S_CURVE, ResponseCurve::S_LUT.points, ResponseCurveGen::POINTS,
+					 uniformInput) <= 0.5, "s-curve", "table points within 0.5 LSB");
+	check(pointError(Type::LOG, ResponseCurve::LOG_LUT.points, ResponseCurveGen::LOG_POINTS,
+					 logInput) <= 0.5, "log", "table points within 0.5 LSB");
+
+	printf("%s\n", sOk ? "PASS" : "FAIL");
+	return sOk ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,59 @@
+#!/bin/sh
+# Build and run the host tests, exit non-zero when one fails.
+#
+#   test/run.sh            all tests
+#   test/run.sh NAME...    only these, e.g. test/run.sh link_campaign
+#
+# Needs gcc, g++ and python3 only, no mbed-os. Binaries go to test/build.
+set -e
+R=$(cd "$(dirname "$0")/.." && pwd)
+B=$R/test/build
+mkdir -p "$B"
+CFLAGS="-std=gnu11 -O2 -Wall -I$R"
+CXXFLAGS="-std=gnu++14 -O2 -Wall -Wextra -I$R"
+
+# Transport, port and NTS1 class for the tests that drive the link
+link_objs() {
+	# The Korg sources have a few unused variables, keep the output quiet
+	gcc $CFLAGS -Wno-unused-variable -Wno-unused-but-set-variable \
+		-c "$R/nts1_iface.c" -o "$B/nts1_iface.o"
+	gcc $CFLAGS -c "$R/nts1_port_host.c" -o "$B/nts1_port_host.o"
+	gcc $CFLAGS -c "$R/nts1_trace.c" -o "$B/nts1_trace.o"
+	echo "$R/nts-1.cpp $R/LinkSim.cpp $B/nts1_iface.o $B/nts1_port_host.o $B/nts1_trace.o"
+}
+
+build() {
+	case $1 in
+	link_campaign)
+		g++ $CXXFLAGS "$R/test/link_campaign.cpp" $(link_objs) -lpthread -o "$B/$1" ;;
+	conditioner_noise)
+		g++ $CXXFLAGS "$R/test/conditioner_noise.cpp" "$R/AnalogConditioner.cpp" -o "$B/$1" ;;
+	tx_stress)
+		g++ $CXXFLAGS "$R/test/tx_stress.cpp" $(link_objs) -lpthread -o "$B/$1" ;;
+	control_map)
+		g++ $CXXFLAGS "$R/test/control_map.cpp" "$R/ControlMap.cpp" \
+			"$R/ModulationScheduler.cpp" "$R/AnalogConditioner.cpp" \
+			"$R/ResponseCurve.cpp" "$R/BinLog.cpp" $(link_objs) -lpthread -o "$B/$1" ;;
+	response_curve)
+		g++ $CXXFLAGS "$R/test/response_curve.cpp" "$R/ResponseCurve.cpp" -o "$B/$1" ;;
+	binlog)
+		# Also runs tools/binlog_decode.py, needs python3
+		g++ $CXXFLAGS -DREPO_ROOT="\"$R\"" "$R/test/binlog.cpp" "$R/BinLog.cpp" -o "$B/$1" ;;
+	led_frame)
+		g++ $CXXFLAGS "$R/test/led_frame.cpp" "$R/LedDriver.cpp" -o "$B/$1" ;;
+	*)
+		echo "unknown test $1"; return 1 ;;
+	esac
+}
+
+TESTS=${*:-"link_campaign tx_stress conditioner_noise control_map response_curve binlog led_frame"}
+failed=0
+for t in $TESTS; do
+	echo "== $t"
+	build "$t"
+	if ! "$B/$t"; then
+		failed=$((failed + 1))
+	fi
+done
+[ $failed -eq 0 ] && echo "all host tests passed" || echo "$failed host test(s) failed"
+exit $failed
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Decode the panel's binary log records back into text.
+
+Reads the raw console stream (a capture file or a serial port) and
+prints it with every BinLog record replaced by its formatted line. Plain
+text in between is passed through. The format strings come from the
+BINLOG_FORMATS table in BinLog.hpp, so decode with the header the
+firmware was built from.
+
+    python3 tools/binlog_decode.py capture.bin
+    python3 tools/binlog_decode.py --port /dev/ttyACM0 --baud 9600
+
+@license: BSD 3-Clause License
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = 0x1E
+CONVERSION = re.compile(r'%l?([udxcs%])')
+
+
+def load_formats(header):
+    """Format strings in ID order from the BINLOG_FORMATS table"""
+    with open(header) as f:
+        text = f.read()
+    table = text[text.index('#define BINLOG_FORMATS'):]
+    table = table[:table.index('\n\n')]
+    return [fmt for _, fmt in re.findall(r'X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', table)]
+
+
+def read_exact(stream, n):
+    data = stream.read(n)
+    while len(data) < n:
+        more = stream.read(n - len(data))
+        if not more:
+            raise EOFError
+        data += more
+    return data
+
+
+def decode_record(stream, formats):
+    fid = read_exact(stream, 1)[0]
+    if fid >= len(formats):
+        return '<binlog: unknown format %u>' % fid
+    fmt = formats[fid]
+    args = []
+    for conv in CONVERSION.findall(fmt):
+        if conv == '%':
+            continue
+        if conv == 's':
+            n = read_exact(stream, 1)[0]
+            args.append(read_exact(stream, n).decode('ascii', 'replace'))
+        else:
+            value, = struct.unpack('<I', read_exact(stream, 4))
+            if conv == 'd' and value >= 0x80000000:
+                value -= 1 << 32
+            args.append(value)
+    return CONVERSION.sub(lambda m: '%' + m.group(1), fmt) % tuple(args)
+
+
+def decode(stream, out, formats):
+    text = bytearray()
+    try:
+        while True:
+            b = read_exact(stream, 1)[0]
+            if b != SYNC:
+                text.append(b)
+                if b == 0x0A:
+                    out.write(text.decode('ascii', 'replace'))
+                    text.clear()
+                continue
+            if text:
+                out.write(text.decode('ascii', 'replace'))
+                text.clear()
+            out.write(decode_record(stream, formats) + '\r\n')
+            out.flush()
+    except EOFError:
+        out.write(text.decode('ascii', 'replace'))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('capture', nargs='?', help='raw capture file, stdin if omitted')
+    parser.add_argument('--port', help='serial port to read instead (needs pyserial)')
+    parser.add_argument('--baud', type=int, default=9600)
+    parser.add_argument('--header', default=os.path.join(here, '..', 'BinLog.hpp'))
+    args = parser.parse_args()
+
+    formats = load_formats(args.header)
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, args.baud)
+    elif args.capture:
+        stream = open(args.capture, 'rb')
+    else:
+        stream = sys.stdin.buffer
+    decode(stream, sys.stdout, formats)
+
+
+if __name__ == '__main__':
+    main()